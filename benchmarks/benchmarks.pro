@@ -0,0 +1,10 @@
+# Standalone benchmarks for the boblight plugin, not part of the plugin build:
+#   qmake benchmarks/benchmarks.pro && make && ./throughput/boblight-throughput
+#   ./stress/boblight-stress --duration 3600
+#   ./recording/boblight-recording
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    throughput \
+    stress \
+    recording
@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "benchmarkutils.h"
+#include "fakeboblightd.h"
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+
+#include <atomic>
+#include <stddef.h>
+#include <time.h>
+
+static thread_local bool s_countAllocations = false;
+static std::atomic<quint64> s_allocations(0);
+
+// Qt's containers allocate with malloc() and realloc() directly, operator new ends up
+// in malloc() too. Replacing these in the executable catches all of them, the glibc
+// implementations are still reachable through their __libc_ names.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    if (s_countAllocations) {
+        s_allocations++;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (s_countAllocations) {
+        s_allocations++;
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    // Growing in place or not, every realloc() is a trip to the allocator
+    if (s_countAllocations) {
+        s_allocations++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+}
+
+namespace BenchmarkUtils
+{
+
+qint64 nsecsElapsed()
+{
+    static QElapsedTimer clock;
+    static bool started = false;
+    if (!started) {
+        clock.start();
+        started = true;
+    }
+    return clock.nsecsElapsed();
+}
+
+qint64 threadCpuNsecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void setCountAllocations(bool enabled)
+{
+    s_countAllocations = enabled;
+}
+
+quint64 allocations()
+{
+    return s_allocations;
+}
+
+bool waitFor(QObject *sender, const char *signal, int timeout)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(sender, signal, &loop, SLOT(quit()));
+    QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    timer.start(timeout);
+    loop.exec();
+    return timer.isActive();
+}
+
+}
+
+FakeServerThread::FakeServerThread(int lightsCount)
+{
+    // Make sure the shared clock is started before any thread uses it
+    BenchmarkUtils::nsecsElapsed();
+
+    m_server = new FakeBoblightd(lightsCount);
+    m_server->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, m_server, &QObject::deleteLater);
+    m_thread.start();
+}
+
+FakeServerThread::~FakeServerThread()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+FakeBoblightd *FakeServerThread::server() const
+{
+    return m_server;
+}
+
+quint16 FakeServerThread::port() const
+{
+    return m_server->port();
+}
+
+bool FakeServerThread::start(quint16 port)
+{
+    bool success = false;
+    QMetaObject::invokeMethod(m_server, "start", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, success), Q_ARG(quint16, port));
+    return success;
+}
+
+void FakeServerThread::stop()
+{
+    QMetaObject::invokeMethod(m_server, "stop", Qt::BlockingQueuedConnection);
+}
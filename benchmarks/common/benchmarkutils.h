@@ -0,0 +1,64 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BENCHMARKUTILS_H
+#define BENCHMARKUTILS_H
+
+#include <QThread>
+#include <QtGlobal>
+
+class FakeBoblightd;
+
+namespace BenchmarkUtils
+{
+    // Monotonic time shared by all threads of the benchmark
+    qint64 nsecsElapsed();
+
+    // CPU time consumed by the calling thread
+    qint64 threadCpuNsecs();
+
+    // Counts malloc(), calloc() and realloc() calls (which includes operator new) made
+    // by the calling thread while enabled. Relies on glibc.
+    void setCountAllocations(bool enabled);
+    quint64 allocations();
+
+    // Waits for a signal while processing events, returns false on timeout
+    bool waitFor(QObject *sender, const char *signal, int timeout = 5000);
+}
+
+// Runs a FakeBoblightd in its own thread
+class FakeServerThread
+{
+public:
+    explicit FakeServerThread(int lightsCount);
+    ~FakeServerThread();
+
+    FakeBoblightd *server() const;
+    quint16 port() const;
+
+    bool start(quint16 port = 0);
+    void stop();
+
+private:
+    QThread m_thread;
+    FakeBoblightd *m_server;
+};
+
+#endif // BENCHMARKUTILS_H
@@ -0,0 +1,44 @@
+# Builds the plugin's light output path (BobClient with the native protocol) together
+# with a fake boblightd, without depending on nymea.
+
+QT += network gui
+QT -= widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# The stub extern-plugininfo.h in here replaces the one generated for the plugin
+INCLUDEPATH += $$PWD $$PWD/../..
+
+SOURCES += \
+    $$PWD/benchmarklogging.cpp \
+    $$PWD/fakeboblightd.cpp \
+    $$PWD/benchmarkutils.cpp \
+    $$PWD/../../bobclient.cpp \
+    $$PWD/../../bobchannel.cpp \
+    $$PWD/../../bobanimator.cpp \
+    $$PWD/../../boboutputstage.cpp \
+    $$PWD/../../bobframemailbox.cpp \
+    $$PWD/../../bobframeclock.cpp \
+    $$PWD/../../bobnativebackend.cpp \
+    $$PWD/../../bobeffectengine.cpp \
+    $$PWD/../../bobstreaminput.cpp \
+    $$PWD/../../bobrecording.cpp \
+    $$PWD/../../bobcompositor.cpp
+
+HEADERS += \
+    $$PWD/extern-plugininfo.h \
+    $$PWD/fakeboblightd.h \
+    $$PWD/benchmarkutils.h \
+    $$PWD/../../bobclient.h \
+    $$PWD/../../bobchannel.h \
+    $$PWD/../../bobanimator.h \
+    $$PWD/../../boboutputstage.h \
+    $$PWD/../../bobframemailbox.h \
+    $$PWD/../../bobframeclock.h \
+    $$PWD/../../bobbackend.h \
+    $$PWD/../../bobnativebackend.h \
+    $$PWD/../../bobeffectengine.h \
+    $$PWD/../../bobstreaminput.h \
+    $$PWD/../../bobrecording.h \
+    $$PWD/../../bobcompositor.h
@@ -0,0 +1,175 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "fakeboblightd.h"
+#include "benchmarkutils.h"
+
+FakeBoblightd::FakeBoblightd(int lightsCount, QObject *parent) :
+    QObject(parent),
+    m_lightsCount(lightsCount),
+    m_frames(0),
+    m_lightUpdates(0),
+    m_bytesReceived(0),
+    m_connectionsAccepted(0),
+    m_priority(255)
+{
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &FakeBoblightd::onNewConnection);
+
+    m_lights.fill(0, lightsCount * 3);
+    m_lastFrame = m_lights;
+}
+
+int FakeBoblightd::lightsCount() const
+{
+    return m_lightsCount;
+}
+
+quint16 FakeBoblightd::port() const
+{
+    return m_port;
+}
+
+quint64 FakeBoblightd::frames() const
+{
+    return m_frames;
+}
+
+quint64 FakeBoblightd::lightUpdates() const
+{
+    return m_lightUpdates;
+}
+
+quint64 FakeBoblightd::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+quint64 FakeBoblightd::connectionsAccepted() const
+{
+    return m_connectionsAccepted;
+}
+
+int FakeBoblightd::priority() const
+{
+    return m_priority;
+}
+
+QVector<quint8> FakeBoblightd::lastFrame() const
+{
+    QMutexLocker locker(&m_frameMutex);
+    return m_lastFrame;
+}
+
+bool FakeBoblightd::start(quint16 port)
+{
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Fake boblightd can't listen on port" << port << m_server->errorString();
+        return false;
+    }
+    m_port = m_server->serverPort();
+    return true;
+}
+
+void FakeBoblightd::stop()
+{
+    m_server->close();
+    foreach (QTcpSocket *client, m_clients.keys()) {
+        client->disconnect(this);
+        client->abort();
+        client->deleteLater();
+    }
+    m_clients.clear();
+}
+
+void FakeBoblightd::processLine(QTcpSocket *client, const QByteArray &line)
+{
+    QList<QByteArray> words = line.split(' ');
+
+    if (words.first() == "set" && words.count() >= 7 && words.at(1) == "light" && words.at(3) == "rgb") {
+        int light = words.at(2).toInt();
+        if (light >= 0 && light < m_lightsCount) {
+            for (int i = 0; i < 3; ++i) {
+                m_lights[light * 3 + i] = qBound(0, qRound(words.at(4 + i).toDouble() * 255), 255);
+            }
+        }
+        m_lightUpdates++;
+    } else if (words.first() == "sync") {
+        {
+            QMutexLocker locker(&m_frameMutex);
+            m_lastFrame = m_lights;
+        }
+        m_frames++;
+        emit frameReceived(BenchmarkUtils::nsecsElapsed());
+    } else if (words.first() == "set" && words.count() == 3 && words.at(1) == "priority") {
+        m_priority = words.at(2).toInt();
+    } else if (words.first() == "hello") {
+        client->write("hello\n");
+    } else if (words.first() == "ping") {
+        client->write("ping 1\n");
+    } else if (words.first() == "get" && words.count() == 2 && words.at(1) == "version") {
+        client->write("version 5\n");
+    } else if (words.first() == "get" && words.count() == 2 && words.at(1) == "lights") {
+        QByteArray reply = "lights " + QByteArray::number(m_lightsCount) + "\n";
+        for (int i = 0; i < m_lightsCount; ++i) {
+            reply += "light " + QByteArray::number(i) + " scan 0 100 0 100\n";
+        }
+        client->write(reply);
+    }
+}
+
+void FakeBoblightd::onNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket *client = m_server->nextPendingConnection();
+        connect(client, &QTcpSocket::readyRead, this, &FakeBoblightd::onReadyRead);
+        connect(client, &QTcpSocket::disconnected, this, &FakeBoblightd::onDisconnected);
+        m_clients.insert(client, QByteArray());
+        m_connectionsAccepted++;
+    }
+}
+
+void FakeBoblightd::onReadyRead()
+{
+    QTcpSocket *client = static_cast<QTcpSocket *>(sender());
+    QByteArray data = client->readAll();
+    m_bytesReceived += data.size();
+
+    QByteArray &buffer = m_clients[client];
+    buffer.append(data);
+
+    int start = 0;
+    int end;
+    while ((end = buffer.indexOf('\n', start)) >= 0) {
+        QByteArray line = buffer.mid(start, end - start).trimmed();
+        if (!line.isEmpty()) {
+            processLine(client, line);
+        }
+        start = end + 1;
+    }
+    buffer.remove(0, start);
+}
+
+void FakeBoblightd::onDisconnected()
+{
+    QTcpSocket *client = static_cast<QTcpSocket *>(sender());
+    m_clients.remove(client);
+    client->deleteLater();
+}
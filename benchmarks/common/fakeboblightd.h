@@ -0,0 +1,88 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FAKEBOBLIGHTD_H
+#define FAKEBOBLIGHTD_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include <atomic>
+
+// Minimal boblightd speaking the text protocol on a local TCP port. It records
+// what it receives so benchmarks can check throughput and latency on the wire.
+// Meant to be moved to its own thread, the statistics getters are thread safe.
+class FakeBoblightd : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FakeBoblightd(int lightsCount, QObject *parent = 0);
+
+    int lightsCount() const;
+    quint16 port() const;
+
+    quint64 frames() const;
+    quint64 lightUpdates() const;
+    quint64 bytesReceived() const;
+    quint64 connectionsAccepted() const;
+    int priority() const;
+
+    // Copy of the light values as of the last sync, 3 bytes per light
+    QVector<quint8> lastFrame() const;
+
+public slots:
+    // Starts listening on the given port, or on a random free one if 0
+    bool start(quint16 port = 0);
+    // Stops listening and drops all clients, like a killed boblightd
+    void stop();
+
+signals:
+    // timestamp is BenchmarkUtils::nsecsElapsed() at the time the frame was complete
+    void frameReceived(qint64 timestamp);
+
+private:
+    QTcpServer *m_server;
+    QHash<QTcpSocket *, QByteArray> m_clients;
+    int m_lightsCount;
+    quint16 m_port = 0;
+
+    QVector<quint8> m_lights;
+    mutable QMutex m_frameMutex;
+    QVector<quint8> m_lastFrame;
+
+    std::atomic<quint64> m_frames;
+    std::atomic<quint64> m_lightUpdates;
+    std::atomic<quint64> m_bytesReceived;
+    std::atomic<quint64> m_connectionsAccepted;
+    std::atomic<int> m_priority;
+
+    void processLine(QTcpSocket *client, const QByteArray &line);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+};
+
+#endif // FAKEBOBLIGHTD_H
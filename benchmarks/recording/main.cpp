@@ -0,0 +1,200 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobrecording.h"
+#include "benchmarkutils.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QTimer>
+#include <QVector>
+#include <QDebug>
+
+#include <stdio.h>
+
+struct RecordingResult
+{
+    double bytesPerFrame = 0;
+    double encodeUsPerFrame = 0;
+    int framesPlayed = 0;
+    int mismatches = 0;
+};
+
+// Frames in which a random share of the lights changes, from none to all of them
+static QVector<QByteArray> generateFrames(int lights, int count)
+{
+    QVector<QByteArray> frames;
+    QByteArray frame(lights * 3, 0);
+    for (int i = 0; i < count; ++i) {
+        int changes = qrand() % 4 == 0 ? lights : qrand() % (lights / 8 + 1);
+        for (int j = 0; j < changes; ++j) {
+            int light = changes == lights ? j : qrand() % lights;
+            frame[light * 3] = char(qrand());
+            frame[light * 3 + 1] = char(qrand());
+            frame[light * 3 + 2] = char(qrand());
+        }
+        frames.append(frame);
+    }
+    return frames;
+}
+
+// Records the frames and plays them back, every frame has to come out as it went in
+static bool roundTrip(const QString &fileName, int lights, int count, RecordingResult *result)
+{
+    QVector<QByteArray> frames = generateFrames(lights, count);
+
+    BobRecorder recorder;
+    if (!recorder.start(fileName, lights)) {
+        qWarning() << "Can't record to" << fileName << recorder.errorString();
+        return false;
+    }
+    qint64 timestamp = 0;
+    qint64 start = BenchmarkUtils::nsecsElapsed();
+    foreach (const QByteArray &frame, frames) {
+        recorder.record(timestamp, reinterpret_cast<const quint8 *>(frame.constData()));
+        timestamp += qrand() % 3;
+    }
+    recorder.stop();
+    result->encodeUsPerFrame = (BenchmarkUtils::nsecsElapsed() - start) / 1000.0 / count;
+    result->bytesPerFrame = double(QFile(fileName).size()) / count;
+
+    BobPlayer player;
+    if (!player.open(fileName)) {
+        qWarning() << "Can't play" << fileName << player.errorString();
+        return false;
+    }
+    if (player.lightsCount() != lights) {
+        qWarning() << "Recording has" << player.lightsCount() << "lights instead of" << lights;
+        return false;
+    }
+
+    QByteArray played(lights * 3, 0);
+    QEventLoop loop;
+    QObject::connect(&player, &BobPlayer::frameAvailable, &loop, [&]() {
+        player.takeFrame(reinterpret_cast<quint8 *>(played.data()), played.size());
+        if (result->framesPlayed >= frames.count() || played != frames.at(result->framesPlayed)) {
+            result->mismatches++;
+        }
+        result->framesPlayed++;
+    });
+    QObject::connect(&player, &BobPlayer::finished, &loop, &QEventLoop::quit);
+    player.play();
+    loop.exec();
+    return result->framesPlayed == count && result->mismatches == 0;
+}
+
+// A header claiming an absurd number of lights and a truncated file must be refused
+// or end the playback, not crash or allocate gigabytes
+static bool rejectsBrokenFiles(const QString &fileName)
+{
+    QByteArray frame(3, 0x7f);
+    BobRecorder recorder;
+    if (!recorder.start(fileName, 1)) {
+        return false;
+    }
+    recorder.record(0, reinterpret_cast<const quint8 *>(frame.constData()));
+    recorder.record(1, reinterpret_cast<const quint8 *>(frame.constData()));
+    recorder.stop();
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadWrite)) {
+        return false;
+    }
+    QByteArray data = file.readAll();
+
+    BobPlayer player;
+    QByteArray huge = data;
+    huge[8] = huge[9] = huge[10] = huge[11] = char(0xff);
+    file.resize(0);
+    file.seek(0);
+    file.write(huge);
+    file.flush();
+    if (player.open(fileName)) {
+        qWarning() << "Opened a recording with" << player.lightsCount() << "lights";
+        return false;
+    }
+
+    file.resize(0);
+    file.seek(0);
+    file.write(data.left(data.size() - 2));
+    file.flush();
+    if (!player.open(fileName)) {
+        return false;
+    }
+    QEventLoop loop;
+    QObject::connect(&player, &BobPlayer::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(5000, &loop, SLOT(quit()));
+    player.play();
+    loop.exec();
+    return !player.playing();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("boblight-recording");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Records random frames, plays them back and checks they come out unchanged.");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Number of frames per light count.", "count", "1000");
+    QCommandLineOption lightsOption("lights", "Comma separated list of light counts.", "counts", "1,64,512,4096");
+    parser.addOption(framesOption);
+    parser.addOption(lightsOption);
+    parser.process(application);
+
+    // Broken files are expected to be reported here
+    QLoggingCategory::setFilterRules("Boblight.debug=false\nBoblight.warning=false");
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "Can't create a temporary directory";
+        return 1;
+    }
+    QString fileName = dir.path() + "/recording.bob";
+
+    if (!rejectsBrokenFiles(fileName)) {
+        printf("Broken recordings are not rejected\n");
+        return 1;
+    }
+
+    int frames = qMax(1, parser.value(framesOption).toInt());
+    printf("%8s %12s %14s %12s %12s\n", "lights", "bytes/frame", "encode us", "played", "mismatches");
+    foreach (const QString &count, parser.value(lightsOption).split(',')) {
+        int lights = count.toInt();
+        if (lights <= 0) {
+            continue;
+        }
+
+        RecordingResult result;
+        bool success = roundTrip(fileName, lights, frames, &result);
+        printf("%8d %12.1f %14.2f %12d %12d\n", lights, result.bytesPerFrame, result.encodeUsPerFrame, result.framesPlayed, result.mismatches);
+        fflush(stdout);
+        if (!success) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,318 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobclient.h"
+#include "bobchannel.h"
+#include "fakeboblightd.h"
+#include "benchmarkutils.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QScopedPointer>
+#include <QFile>
+#include <QTimer>
+#include <QDebug>
+
+#include <stdio.h>
+
+// Resident set size of this process in KiB
+static qint64 residentSetSize()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    foreach (const QByteArray &line, status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return 0;
+}
+
+// Hammers a BobClient with random actions while the fake boblightd behind it gets
+// killed and restarted, optionally with a different number of lights each time.
+class StressRun : public QObject
+{
+    Q_OBJECT
+public:
+    int lights = 64;
+    int actionsPerSecond = 2000;
+    int killInterval = 5000;
+    int downtime = 500;
+    bool varyLights = true;
+    int reconnectTimeout = 10000;
+
+    bool start()
+    {
+        m_server.reset(new FakeServerThread(lights));
+        if (!m_server->start()) {
+            qWarning() << "Can't start the fake boblightd";
+            return false;
+        }
+        m_port = m_server->port();
+
+        m_client.reset(new BobClient("127.0.0.1", m_port, BobClient::ProtocolNative));
+        m_client->setFrameRate(60);
+
+        // Allocations are counted only while the client handles a tick, the actions
+        // in between allocate on their own. The client's slot runs between these two.
+        m_clock.setFrameRate(60);
+        connect(&m_clock, &BobFrameClock::tick, this, [this]() {
+            m_frameAllocations -= BenchmarkUtils::allocations();
+            BenchmarkUtils::setCountAllocations(true);
+        });
+        m_client->setFrameClock(&m_clock);
+        connect(&m_clock, &BobFrameClock::tick, this, [this]() {
+            BenchmarkUtils::setCountAllocations(false);
+            m_frameAllocations += BenchmarkUtils::allocations();
+        });
+
+        connect(m_client.data(), &BobClient::connectionChanged, this, &StressRun::onConnectionChanged);
+        m_client->connectToBoblight();
+
+        connect(&m_actionTimer, &QTimer::timeout, this, &StressRun::runActions);
+        m_actionTimer.start(1);
+        connect(&m_killTimer, &QTimer::timeout, this, &StressRun::killServer);
+        m_killTimer.start(killInterval);
+        m_running.start();
+        return true;
+    }
+
+    // Fails if the client didn't come back after the last restart
+    bool healthy() const
+    {
+        return !m_restarted.isValid() || m_client->connected() || m_restarted.elapsed() < reconnectTimeout;
+    }
+
+    bool connected() const { return m_client->connected(); }
+    int channels() const { return m_client->findChildren<BobChannel *>().count(); }
+    int lightsCount() const { return m_client->lightsCount(); }
+    quint64 actions() const { return m_actions; }
+    quint64 kills() const { return m_kills; }
+    quint64 reconnects() const { return m_reconnects; }
+    quint64 framesSent() const { return m_client->framesSent(); }
+    quint64 frameAllocations() const { return m_frameAllocations; }
+    qint64 longestOutage() const { return m_longestOutage; }
+
+private:
+    // The client goes first, it still talks to the clock while being destroyed
+    BobFrameClock m_clock;
+    QScopedPointer<FakeServerThread> m_server;
+    QScopedPointer<BobClient> m_client;
+    QTimer m_actionTimer;
+    QTimer m_killTimer;
+    QElapsedTimer m_running;
+    QElapsedTimer m_restarted;
+    QElapsedTimer m_disconnectedSince;
+    quint16 m_port = 0;
+
+    quint64 m_actions = 0;
+    quint64 m_kills = 0;
+    quint64 m_reconnects = 0;
+    quint64 m_frameAllocations = 0;
+    qint64 m_longestOutage = 0;
+
+    void runActions()
+    {
+        // The timer doesn't fire exactly every ms, catch up on what should have run by now
+        quint64 due = m_running.elapsed() * actionsPerSecond / 1000;
+        int count = qMax(1, m_client->lightsCount());
+        for (; m_actions < due; ++m_actions) {
+            int channel = qrand() % count;
+            QColor color = QColor::fromHsv(qrand() % 360, 255, 255);
+            switch (qrand() % 16) {
+            case 0:
+                m_client->setPower(channel, qrand() % 2);
+                break;
+            case 1:
+                m_client->setBrightness(channel, qrand() % 101);
+                break;
+            case 2: {
+                QList<QColor> colors;
+                for (int i = channel; i < count; ++i) {
+                    colors.append(color);
+                }
+                m_client->setColors(channel, colors, qrand() % 500, static_cast<BobAnimator::Easing>(qrand() % 4));
+                break;
+            }
+            case 3:
+                m_client->startEffect(static_cast<BobEffectEngine::Effect>(1 + qrand() % 4), color, qrand() % 101, channel, count - 1);
+                break;
+            case 4:
+                m_client->stopEffect();
+                break;
+            case 5:
+                m_client->setOverride(channel, channel, color);
+                break;
+            case 6:
+                m_client->clearOverride(0, count - 1);
+                break;
+            case 7:
+                m_client->setLayer(static_cast<BobCompositor::Layer>(qrand() % BobCompositor::LayerCount), qrand() % 256,
+                                   static_cast<BobCompositor::BlendMode>(qrand() % 4));
+                break;
+            default:
+                m_client->setColor(channel, color);
+                break;
+            }
+        }
+    }
+
+    void killServer()
+    {
+        m_kills++;
+        m_restarted.invalidate();
+        m_server->stop();
+        QTimer::singleShot(downtime, this, &StressRun::restartServer);
+    }
+
+    void restartServer()
+    {
+        // A different light count makes the client drop or add channels on reconnect
+        int count = varyLights && m_kills % 2 ? qMax(1, lights / 2) : lights;
+        if (count != m_server->server()->lightsCount()) {
+            m_server.reset(new FakeServerThread(count));
+        }
+        if (!m_server->start(m_port)) {
+            qWarning() << "Can't restart the fake boblightd on port" << m_port;
+            QTimer::singleShot(downtime, this, &StressRun::restartServer);
+            return;
+        }
+        m_restarted.start();
+        // Don't wait for the backoff, like the plugin does when the network comes back
+        m_client->reconnectNow();
+    }
+
+    void onConnectionChanged()
+    {
+        if (!m_client->connected()) {
+            m_disconnectedSince.start();
+            return;
+        }
+        if (m_disconnectedSince.isValid()) {
+            m_reconnects++;
+            m_longestOutage = qMax(m_longestOutage, m_disconnectedSince.elapsed());
+        }
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("boblight-stress");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs random actions against a BobClient while a fake boblightd keeps getting killed and restarted. "
+                                     "Reports memory growth, allocations per frame and reconnects.");
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Duration in seconds, 0 runs until interrupted.", "secs", "60");
+    QCommandLineOption lightsOption("lights", "Number of lights of the fake boblightd.", "count", "64");
+    QCommandLineOption actionsOption("actions", "Actions per second.", "count", "2000");
+    QCommandLineOption killOption("kill-interval", "Time between killing boblightd in milliseconds.", "msecs", "5000");
+    QCommandLineOption downtimeOption("downtime", "Time boblightd stays away in milliseconds.", "msecs", "500");
+    QCommandLineOption fixedLightsOption("fixed-lights", "Restart boblightd with the same number of lights every time.");
+    QCommandLineOption reportOption("report-interval", "Time between reports in seconds.", "secs", "10");
+    QCommandLineOption warmupOption("warmup", "Seconds before the RSS baseline is taken.", "secs", "10");
+    QCommandLineOption maxGrowthOption("max-rss-growth", "Fail if RSS grows by more than this many KiB after the warmup, 0 only reports.", "kib", "0");
+    parser.addOption(durationOption);
+    parser.addOption(lightsOption);
+    parser.addOption(actionsOption);
+    parser.addOption(killOption);
+    parser.addOption(downtimeOption);
+    parser.addOption(fixedLightsOption);
+    parser.addOption(reportOption);
+    parser.addOption(warmupOption);
+    parser.addOption(maxGrowthOption);
+    parser.process(application);
+
+    // Connection errors are expected all the time here
+    QLoggingCategory::setFilterRules("Boblight.debug=false\nBoblight.warning=false");
+
+    StressRun run;
+    run.lights = qMax(1, parser.value(lightsOption).toInt());
+    run.actionsPerSecond = qMax(1, parser.value(actionsOption).toInt());
+    run.killInterval = qMax(parser.value(downtimeOption).toInt() + 1, parser.value(killOption).toInt());
+    run.downtime = qMax(0, parser.value(downtimeOption).toInt());
+    run.varyLights = !parser.isSet(fixedLightsOption);
+    if (!run.start()) {
+        return 1;
+    }
+
+    qint64 duration = parser.value(durationOption).toLongLong() * 1000;
+    qint64 warmup = parser.value(warmupOption).toLongLong() * 1000;
+    qint64 maxGrowth = parser.value(maxGrowthOption).toLongLong();
+    qint64 baseline = 0;
+    qint64 growth = 0;
+    quint64 lastFrames = 0;
+    quint64 lastAllocations = 0;
+    int result = 0;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    printf("%10s %10s %8s %10s %12s %14s %10s %10s %10s %12s\n", "hours", "actions", "kills", "reconnects", "outage ms",
+           "allocs/frame", "rss KiB", "growth", "lights", "channels");
+    fflush(stdout);
+
+    QTimer reportTimer;
+    QObject::connect(&reportTimer, &QTimer::timeout, [&]() {
+        qint64 rss = residentSetSize();
+        if (!baseline && elapsed.elapsed() >= warmup) {
+            baseline = rss;
+        }
+        growth = baseline ? rss - baseline : 0;
+
+        quint64 frames = run.framesSent() - lastFrames;
+        quint64 allocations = run.frameAllocations() - lastAllocations;
+        lastFrames = run.framesSent();
+        lastAllocations = run.frameAllocations();
+
+        printf("%10.3f %10llu %8llu %10llu %12lld %14.2f %10lld %10lld %10d %12d\n", elapsed.elapsed() / 3600000.0,
+               run.actions(), run.kills(), run.reconnects(), run.longestOutage(), frames ? double(allocations) / frames : 0.0,
+               rss, growth, run.lightsCount(), run.channels());
+        fflush(stdout);
+
+        // Channels are kept across reconnects, there must never be more than boblightd has lights
+        if (run.connected() && run.channels() != run.lightsCount()) {
+            qWarning() << "Channel count" << run.channels() << "doesn't match the" << run.lightsCount() << "lights of boblightd";
+            result = 1;
+        } else if (!run.healthy()) {
+            qWarning() << "Client didn't reconnect after boblightd came back";
+            result = 1;
+        } else if (maxGrowth > 0 && growth > maxGrowth) {
+            qWarning() << "RSS grew by" << growth << "KiB";
+            result = 1;
+        }
+        if (result || (duration > 0 && elapsed.elapsed() >= duration)) {
+            application.quit();
+        }
+    });
+    reportTimer.start(qMax(1, parser.value(reportOption).toInt()) * 1000);
+
+    application.exec();
+
+    printf("%s after %.3f crash-free hours, RSS growth %lld KiB\n", result ? "FAILED" : "Passed", elapsed.elapsed() / 3600000.0, growth);
+    return result;
+}
+
+#include "main.moc"
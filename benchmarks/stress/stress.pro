@@ -0,0 +1,7 @@
+include(../common/common.pri)
+
+TARGET = boblight-stress
+TEMPLATE = app
+
+SOURCES += \
+    main.cpp
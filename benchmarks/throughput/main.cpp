@@ -0,0 +1,200 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobclient.h"
+#include "fakeboblightd.h"
+#include "benchmarkutils.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QTimer>
+#include <QDebug>
+
+#include <stdio.h>
+
+struct ThroughputResult
+{
+    double framesPerSecond = 0;
+    double cpuPerFrame = 0;
+    double allocationsPerFrame = 0;
+    double bytesPerFrame = 0;
+};
+
+struct LatencyResult
+{
+    double average = 0;
+    double maximum = 0;
+};
+
+static bool connectClient(BobClient *client)
+{
+    client->connectToBoblight();
+    if (!client->connected()) {
+        BenchmarkUtils::waitFor(client, SIGNAL(connectFinished(bool)));
+    }
+    return client->connected();
+}
+
+// Retargets all channels on every frame at the highest frame rate the client supports
+static bool measureThroughput(int lights, int duration, ThroughputResult *result)
+{
+    FakeServerThread serverThread(lights);
+    if (!serverThread.start()) {
+        return false;
+    }
+
+    BobClient client("127.0.0.1", serverThread.port(), BobClient::ProtocolNative);
+    if (!connectClient(&client)) {
+        qWarning() << "Can't connect to the fake boblightd";
+        return false;
+    }
+    client.setFrameRate(1000);
+    for (int i = 0; i < lights; ++i) {
+        client.setPower(i, true);
+    }
+
+    QList<QColor> colors[2];
+    for (int i = 0; i < lights; ++i) {
+        colors[0].append(QColor::fromHsv(i * 360 / lights, 255, 255));
+        colors[1].append(QColor::fromHsv((i * 360 / lights + 180) % 360, 255, 128));
+    }
+
+    int toggle = 0;
+    QObject::connect(client.frameClock(), &BobFrameClock::tick, [&client, &colors, &toggle]() {
+        toggle = 1 - toggle;
+        client.setColors(0, colors[toggle]);
+    });
+
+    quint64 serverFrames = serverThread.server()->frames();
+    quint64 serverBytes = serverThread.server()->bytesReceived();
+    quint64 clientFrames = client.frameClock()->frames();
+    quint64 allocations = BenchmarkUtils::allocations();
+    qint64 cpu = BenchmarkUtils::threadCpuNsecs();
+    qint64 start = BenchmarkUtils::nsecsElapsed();
+
+    BenchmarkUtils::setCountAllocations(true);
+    QEventLoop loop;
+    QTimer::singleShot(duration, &loop, SLOT(quit()));
+    client.setColors(0, colors[0]);
+    loop.exec();
+    BenchmarkUtils::setCountAllocations(false);
+
+    double seconds = (BenchmarkUtils::nsecsElapsed() - start) / 1e9;
+    quint64 sent = qMax<quint64>(1, client.frameClock()->frames() - clientFrames);
+    quint64 received = serverThread.server()->frames() - serverFrames;
+
+    result->framesPerSecond = received / seconds;
+    result->cpuPerFrame = (BenchmarkUtils::threadCpuNsecs() - cpu) / 1000.0 / sent;
+    result->allocationsPerFrame = double(BenchmarkUtils::allocations() - allocations) / sent;
+    result->bytesPerFrame = received ? double(serverThread.server()->bytesReceived() - serverBytes) / received : 0;
+    return true;
+}
+
+// Time from a color change to the first frame carrying it arriving at boblightd
+static bool measureLatency(int lights, int samples, LatencyResult *result)
+{
+    FakeServerThread serverThread(lights);
+    if (!serverThread.start()) {
+        return false;
+    }
+
+    BobClient client("127.0.0.1", serverThread.port(), BobClient::ProtocolNative);
+    if (!connectClient(&client)) {
+        qWarning() << "Can't connect to the fake boblightd";
+        return false;
+    }
+    client.setPower(0, true);
+
+    qint64 requested = 0;
+    qint64 arrived = 0;
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+    QObject::connect(serverThread.server(), &FakeBoblightd::frameReceived, &loop, [&requested, &arrived, &loop](qint64 timestamp) {
+        if (requested && !arrived && timestamp >= requested) {
+            arrived = timestamp;
+            loop.quit();
+        }
+    });
+
+    qint64 total = 0;
+    for (int i = 0; i < samples; ++i) {
+        arrived = 0;
+        requested = BenchmarkUtils::nsecsElapsed();
+        client.setColor(i % lights, QColor::fromHsv(i * 37 % 360, 255, 255));
+        timer.start(1000);
+        loop.exec();
+        if (!arrived) {
+            qWarning() << "Frame didn't arrive within a second";
+            return false;
+        }
+        total += arrived - requested;
+        result->maximum = qMax(result->maximum, (arrived - requested) / 1e6);
+
+        // Spread the samples over the phase of the frame clock
+        timer.start(7 + i % 13);
+        loop.exec();
+    }
+    result->average = total / 1e6 / samples;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("boblight-throughput");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures throughput and latency of the boblight light output against a fake boblightd.");
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Duration of each throughput run in milliseconds.", "msecs", "2000");
+    QCommandLineOption samplesOption("samples", "Number of latency samples per light count.", "count", "50");
+    QCommandLineOption lightsOption("lights", "Comma separated list of light counts.", "counts", "1,64,512,4096");
+    parser.addOption(durationOption);
+    parser.addOption(samplesOption);
+    parser.addOption(lightsOption);
+    parser.process(application);
+
+    // Only the numbers are of interest here
+    QLoggingCategory::setFilterRules("Boblight.debug=false");
+
+    printf("%8s %12s %14s %14s %14s %14s %14s\n", "lights", "frames/s", "cpu/frame us", "allocs/frame", "bytes/frame", "latency ms", "latency max");
+    foreach (const QString &count, parser.value(lightsOption).split(',')) {
+        int lights = count.toInt();
+        if (lights <= 0) {
+            continue;
+        }
+
+        ThroughputResult throughput;
+        LatencyResult latency;
+        if (!measureThroughput(lights, parser.value(durationOption).toInt(), &throughput)
+                || !measureLatency(lights, parser.value(samplesOption).toInt(), &latency)) {
+            return 1;
+        }
+
+        printf("%8d %12.1f %14.2f %14.2f %14.0f %14.2f %14.2f\n", lights, throughput.framesPerSecond, throughput.cpuPerFrame,
+               throughput.allocationsPerFrame, throughput.bytesPerFrame, latency.average, latency.maximum);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobanimator.h"
+
+// Marks a transition which has been requested but not picked up by a frame yet
+static const qint64 pendingStart = -1;
+
+// Tangents at the start and end of a transition in multiples of its distance, per easing curve
+static const float startTangent[] = { 1, 0, 0, 2 };
+static const float endTangent[] = { 1, 0, 2, 0 };
+
+static inline int component(QRgb color, int index)
+{
+    return (color >> (24 - index * 8)) & 0xff;
+}
+
+BobAnimator::BobAnimator()
+{
+}
+
+void BobAnimator::resize(int count)
+{
+    m_start.fill(qRgba(0, 0, 0, 255), count);
+    m_target.fill(qRgba(0, 0, 0, 255), count);
+    m_current.fill(qRgba(0, 0, 0, 255), count);
+    m_startTime.fill(0, count);
+    m_durations.fill(m_duration, count);
+    m_easings.fill(m_easing, count);
+    m_active.fill(false, count);
+    m_velocity.fill(0, count * 4);
+    m_retargeted.fill(false, count);
+    m_running = 0;
+}
+
+int BobAnimator::count() const
+{
+    return m_current.count();
+}
+
+int BobAnimator::duration() const
+{
+    return m_duration;
+}
+
+void BobAnimator::setDuration(int msecs)
+{
+    m_duration = qMax(0, msecs);
+}
+
+BobAnimator::Easing BobAnimator::easing() const
+{
+    return m_easing;
+}
+
+void BobAnimator::setEasing(Easing easing)
+{
+    if (easing != EasingDefault) {
+        m_easing = easing;
+    }
+}
+
+void BobAnimator::startTransition(int channel, QRgb target, int duration, Easing easing)
+{
+    if (channel < 0 || channel >= m_current.count()) {
+        return;
+    }
+
+    // Already there or on the way, don't restart the timeline
+    if (m_target.at(channel) == target && (m_active.at(channel) || m_current.at(channel) == target)) {
+        return;
+    }
+
+    // Continue from where the last frame left the channel, with the speed it had there
+    float velocity[4];
+    velocityAt(channel, m_lastAdvance, velocity);
+
+    if (!m_active.at(channel)) {
+        m_active[channel] = true;
+        m_running++;
+    }
+    m_start[channel] = m_current.at(channel);
+    m_target[channel] = target;
+    m_startTime[channel] = pendingStart;
+    m_durations[channel] = duration < 0 ? m_duration : duration;
+    m_easings[channel] = easing == EasingDefault ? m_easing : easing;
+    m_retargeted[channel] = false;
+    for (int c = 0; c < 4; ++c) {
+        m_velocity[channel * 4 + c] = velocity[c];
+        m_retargeted[channel] = m_retargeted.at(channel) || velocity[c] != 0;
+    }
+
+    // A moving channel continues from the last frame right away instead of pausing for one
+    if (m_retargeted.at(channel)) {
+        m_startTime[channel] = m_lastAdvance;
+    }
+}
+
+void BobAnimator::finishTransitions()
+{
+    m_current = m_target;
+    m_active.fill(false);
+    m_running = 0;
+}
+
+bool BobAnimator::advance(qint64 now)
+{
+    m_lastAdvance = now;
+    if (m_running == 0) {
+        return false;
+    }
+
+    QRgb *current = m_current.data();
+    const QRgb *start = m_start.constData();
+    const QRgb *target = m_target.constData();
+    qint64 *startTime = m_startTime.data();
+    const int *durations = m_durations.constData();
+    const quint8 *easings = m_easings.constData();
+    const float *velocity = m_velocity.constData();
+    const bool *retargeted = m_retargeted.constData();
+    bool *active = m_active.data();
+
+    for (int i = 0; i < m_current.count(); ++i) {
+        if (!active[i]) {
+            continue;
+        }
+
+        if (startTime[i] == pendingStart) {
+            startTime[i] = now;
+        }
+
+        qint64 elapsed = now - startTime[i];
+        if (elapsed >= durations[i]) {
+            current[i] = target[i];
+            active[i] = false;
+            m_running--;
+            continue;
+        }
+
+        // Hermite basis functions at the current position
+        float t = float(elapsed) / durations[i];
+        float t2 = t * t;
+        float t3 = t2 * t;
+        float h00 = 2 * t3 - 3 * t2 + 1;
+        float h10 = t3 - 2 * t2 + t;
+        float h01 = 3 * t2 - 2 * t3;
+        float h11 = t3 - t2;
+
+        int value[4];
+        for (int c = 0; c < 4; ++c) {
+            int p0 = component(start[i], c);
+            int p1 = component(target[i], c);
+            float m0 = retargeted[i] ? velocity[i * 4 + c] * durations[i] : startTangent[easings[i]] * (p1 - p0);
+            float m1 = endTangent[easings[i]] * (p1 - p0);
+            value[c] = qBound(0, int(h00 * p0 + h01 * p1 + h10 * m0 + h11 * m1 + 0.5f), 255);
+        }
+        current[i] = qRgba(value[1], value[2], value[3], value[0]);
+    }
+
+    return m_running > 0;
+}
+
+void BobAnimator::velocityAt(int channel, qint64 time, float *velocity) const
+{
+    velocity[0] = velocity[1] = velocity[2] = velocity[3] = 0;
+    if (!m_active.at(channel)) {
+        return;
+    }
+
+    if (m_startTime.at(channel) == pendingStart) {
+        // Not moving yet
+        return;
+    }
+
+    int duration = m_durations.at(channel);
+    if (duration <= 0) {
+        return;
+    }
+
+    // Derivatives of the Hermite basis functions
+    float t = qBound<float>(0, float(time - m_startTime.at(channel)) / duration, 1);
+    float t2 = t * t;
+    float d00 = 6 * t2 - 6 * t;
+    float d10 = 3 * t2 - 4 * t + 1;
+    float d01 = 6 * t - 6 * t2;
+    float d11 = 3 * t2 - 2 * t;
+
+    int easing = m_easings.at(channel);
+    for (int c = 0; c < 4; ++c) {
+        int p0 = component(m_start.at(channel), c);
+        int p1 = component(m_target.at(channel), c);
+        float m0 = m_retargeted.at(channel) ? m_velocity.at(channel * 4 + c) * duration : startTangent[easing] * (p1 - p0);
+        float m1 = endTangent[easing] * (p1 - p0);
+        velocity[c] = (d00 * p0 + d01 * p1 + d10 * m0 + d11 * m1) / duration;
+    }
+}
+
+bool BobAnimator::running() const
+{
+    return m_running > 0;
+}
+
+QRgb BobAnimator::value(int channel) const
+{
+    return m_current.value(channel);
+}
+
+const QRgb *BobAnimator::values() const
+{
+    return m_current.constData();
+}
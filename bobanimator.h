@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBANIMATOR_H
+#define BOBANIMATOR_H
+
+#include <QColor>
+#include <QVector>
+
+// Animates the colors of all channels of a BobClient. The state of all channels is
+// kept in flat arrays and advanced in a single pass for every frame.
+//
+// Every transition is a cubic Hermite segment per color component. The easing curve
+// picks the tangents at both ends, linear, in, out and in-out come out exactly. A
+// channel retargeted while on its way starts the new segment with the velocity it
+// had, so dragging a slider doesn't make the lights stop and start again.
+class BobAnimator
+{
+public:
+    enum Easing {
+        EasingDefault = -1,
+        EasingLinear,
+        EasingInOut,
+        EasingIn,
+        EasingOut
+    };
+
+    BobAnimator();
+
+    void resize(int count);
+    int count() const;
+
+    // Used for transitions started without their own duration/easing
+    int duration() const;
+    void setDuration(int msecs);
+    Easing easing() const;
+    void setEasing(Easing easing);
+
+    // Fades the channel from its current value to target. Transitions started between
+    // two frames all start on the timestamp of the next frame, only the last target
+    // requested for a channel until then counts. A negative duration uses the default.
+    void startTransition(int channel, QRgb target, int duration = -1, Easing easing = EasingDefault);
+
+    // Jumps all channels to their targets
+    void finishTransitions();
+
+    // Advances all running transitions to the given time, returns true while any of
+    // them is still running.
+    bool advance(qint64 now);
+    bool running() const;
+
+    QRgb value(int channel) const;
+    const QRgb *values() const;
+
+private:
+    QVector<QRgb> m_start;
+    QVector<QRgb> m_target;
+    QVector<QRgb> m_current;
+    QVector<qint64> m_startTime;
+    QVector<int> m_durations;
+    QVector<quint8> m_easings;
+    QVector<bool> m_active;
+    // Components per millisecond at the start of a retargeted transition, 4 per channel
+    QVector<float> m_velocity;
+    QVector<bool> m_retargeted;
+
+    int m_duration = 1500;
+    Easing m_easing = EasingLinear;
+    int m_running = 0;
+    qint64 m_lastAdvance = 0;
+
+    void velocityAt(int channel, qint64 time, float *velocity) const;
+};
+
+#endif // BOBANIMATOR_H
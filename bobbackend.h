@@ -0,0 +1,111 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBBACKEND_H
+#define BOBBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+
+// The most recent send times of a backend
+class BobSendLatencies
+{
+public:
+    BobSendLatencies() { m_samples.fill(0, 256); }
+
+    void add(qint64 nsecs)
+    {
+        m_samples[m_index] = nsecs;
+        m_index = (m_index + 1) % m_samples.count();
+        m_count = qMin(m_count + 1, m_samples.count());
+    }
+
+    // In milliseconds, 0 as long as nothing has been sent
+    double percentile(int percentile) const
+    {
+        if (m_count == 0) {
+            return 0;
+        }
+        QVector<qint64> samples = m_samples.mid(0, m_count);
+        QVector<qint64>::iterator nth = samples.begin() + qBound(0, (m_count - 1) * percentile / 100, m_count - 1);
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth / 1000000.0;
+    }
+
+private:
+    QVector<qint64> m_samples;
+    int m_index = 0;
+    int m_count = 0;
+};
+
+// Transport to a boblightd instance. BobClient renders the frames, a backend only
+// knows how to get them onto the wire.
+class BobBackend : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobBackend(QObject *parent = 0) : QObject(parent) {}
+    virtual ~BobBackend() {}
+
+    // Asynchronous, connectFinished() is emitted once the attempt resolved.
+    // Does nothing if connected or if an attempt is already running.
+    virtual void connectToServer(const QString &host, int port, int priority) = 0;
+    virtual void disconnectFromServer() = 0;
+    virtual bool connected() const = 0;
+    virtual bool connecting() const = 0;
+
+    virtual int lightsCount() const = 0;
+    virtual void setPriority(int priority) = 0;
+
+    // rgb holds 3 bytes per light, lightsCount() lights in total
+    virtual bool sendFrame(const quint8 *rgb) = 0;
+
+    // Checks the connection while idle. Returns false if the backend can't do that on
+    // its own, the current frame is sent again instead then.
+    virtual bool ping() { return false; }
+
+    virtual QString errorString() const = 0;
+
+    // Frames actually handed to boblightd, frames replaced by a newer one before they
+    // could be sent and bytes put on the wire
+    virtual quint64 framesWritten() const { return m_framesWritten; }
+    quint64 framesSkipped() const { return m_framesSkipped; }
+    quint64 bytesWritten() const { return m_bytesWritten; }
+    // False if the backend can't tell how many bytes go out
+    virtual bool countsBytesWritten() const { return true; }
+
+    // Time it takes until a frame actually left, percentile in 0..100, result in ms
+    virtual double sendLatency(int percentile) const { return m_sendLatencies.percentile(percentile); }
+
+protected:
+    BobSendLatencies m_sendLatencies;
+    quint64 m_framesWritten = 0;
+    quint64 m_framesSkipped = 0;
+    quint64 m_bytesWritten = 0;
+
+signals:
+    void connectFinished(bool success);
+    void disconnected();
+};
+
+#endif // BOBBACKEND_H
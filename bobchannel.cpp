@@ -24,9 +24,6 @@ BobChannel::BobChannel(const int &id, QObject *parent) :
     QObject(parent),
     m_id(id)
 {
-    m_animation = new QPropertyAnimation(this, "finalColor", this);
-    m_animation->setDuration(1500);
-    m_animation->setEasingCurve(QEasingCurve::Linear);
 }
 
 int BobChannel::id() const
@@ -42,15 +39,8 @@ QColor BobChannel::color() const
 void BobChannel::setColor(const QColor &color)
 {
     m_color = color;
+    m_target = color;
     emit colorChanged();
-
-    if (m_animation->state() == QPropertyAnimation::Running) {
-        m_animation->stop();
-    }
-
-    m_animation->setStartValue(m_finalColor);
-    m_animation->setEndValue(color);
-    m_animation->start();
 }
 
 bool BobChannel::power() const
@@ -62,28 +52,14 @@ void BobChannel::setPower(bool power)
 {
     if (power != m_power) {
         m_power = power;
-        emit powerChanged();
-
-        if (m_animation->state() == QPropertyAnimation::Running) {
-            m_animation->stop();
-        }
 
-        QColor target = m_color;
-        target.setAlpha(target.alpha() * (m_power ? 1 : 0));
-        m_animation->setStartValue(m_finalColor);
-        m_animation->setEndValue(target);
-        m_animation->start();
+        m_target = m_color;
+        m_target.setAlpha(m_target.alpha() * (m_power ? 1 : 0));
+        emit powerChanged();
     }
 }
 
-QColor BobChannel::finalColor() const
+QColor BobChannel::target() const
 {
-    return m_finalColor;
+    return m_target;
 }
-
-void BobChannel::setFinalColor(const QColor &color)
-{
-    m_finalColor = color;
-    emit finalColorChanged();
-}
-
@@ -23,7 +23,6 @@
 
 #include <QColor>
 #include <QObject>
-#include <QPropertyAnimation>
 
 class BobChannel : public QObject
 {
@@ -31,9 +30,6 @@ class BobChannel : public QObject
     Q_PROPERTY(bool power READ power WRITE setPower NOTIFY powerChanged)
     Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
 
-    // don't directly write to this, the propertyAnimation requires a writable property tho...
-    Q_PROPERTY(QColor finalColor READ finalColor WRITE setFinalColor NOTIFY finalColorChanged)
-
 public:
     explicit BobChannel(const int &id, QObject *parent = 0);
 
@@ -45,20 +41,18 @@ public:
     bool power() const;
     void setPower(bool power);
 
-    QColor finalColor() const;
-    void setFinalColor(const QColor &color);
+    // The color the output of this channel should fade to
+    QColor target() const;
 
 private:
-    QPropertyAnimation *m_animation;
     int m_id;
     bool m_power = false;
     QColor m_color = Qt::white;
-    QColor m_finalColor = Qt::black;
+    QColor m_target = Qt::black;
 
 signals:
     void colorChanged();
     void brightnessChanged();
-    void finalColorChanged();
     void powerChanged();
 
 };
@@ -22,57 +22,164 @@
 #include "bobclient.h"
 #include "extern-plugininfo.h"
 
-#include "libboblight/boblight.h"
+#include "bobnativebackend.h"
+#ifdef WITH_LIBBOBLIGHT
+#include "boblibbackend.h"
+#endif
 
 #include <QDebug>
-#include <QtConcurrent>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#else
+#include <QCoreApplication>
+#include <QDateTime>
+#endif
 
-BobClient::BobClient(const QString &host, const int &port, QObject *parent) :
+static const int minimumReconnectDelay = 1000;
+static const int maximumReconnectDelay = 60000;
+// A connection has to stay up this long before the backoff starts over
+static const int stableConnectionTime = 30000;
+
+// Random value in 0..bound-1 which differs between processes, unlike an unseeded qrand()
+static int randomJitter(int bound)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    return QRandomGenerator::global()->bounded(bound);
+#else
+    static bool seeded = false;
+    if (!seeded) {
+        qsrand(QDateTime::currentMSecsSinceEpoch() ^ QCoreApplication::applicationPid());
+        seeded = true;
+    }
+    return qrand() % bound;
+#endif
+}
+
+BobClient::BobClient(const QString &host, const int &port, Protocol protocol, QObject *parent) :
     QObject(parent),
     m_host(host),
     m_port(port),
     m_connected(false)
 {
-    m_syncTimer = new QTimer(this);
-    m_syncTimer->setSingleShot(false);
-    m_syncTimer->setInterval(50);
+#ifdef WITH_LIBBOBLIGHT
+    if (protocol == ProtocolLibBoblight) {
+        m_backend = new BobLibBackend(this);
+    }
+#endif
+    if (!m_backend) {
+        if (protocol == ProtocolLibBoblight) {
+            qCWarning(dcBoblight) << "Built without libboblight support. Falling back to the native protocol.";
+        }
+        m_backend = new BobNativeBackend(this);
+    }
+    connect(m_backend, &BobBackend::connectFinished, this, &BobClient::onConnectFinished);
+    connect(m_backend, &BobBackend::disconnected, this, &BobClient::onDisconnected);
+
+    m_clock.start();
+
+    m_ownFrameClock = new BobFrameClock(this);
+    m_ownFrameClock->setFrameRate(m_frameRate);
+    m_frameClock = m_ownFrameClock;
+
+    connect(m_frameClock, SIGNAL(tick()), this, SLOT(onTick()));
+
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setSingleShot(true);
+
+    connect(m_reconnectTimer, SIGNAL(timeout()), this, SLOT(connectToBoblight()));
+
+    m_metricsTimer = new QTimer(this);
+    m_metricsTimer->setSingleShot(false);
+    m_metricsTimer->setInterval(10000);
 
-    connect(m_syncTimer, SIGNAL(timeout()), this, SLOT(sync()));
+    connect(m_metricsTimer, SIGNAL(timeout()), this, SIGNAL(metricsChanged()));
+
+    // Checks the connection now and then while idle, so a boblightd which went away
+    // is noticed before the next change
+    m_keepAliveTimer = new QTimer(this);
+    m_keepAliveTimer->setSingleShot(false);
+    m_keepAliveTimer->setInterval(5000);
+
+    connect(m_keepAliveTimer, SIGNAL(timeout()), this, SLOT(onKeepAlive()));
 }
 
 BobClient::~BobClient()
 {
-    if (m_boblight) {
-        boblight_destroy(m_boblight);
-    }
+    // A shared clock would otherwise keep ticking for a client which is gone
+    setTicking(false);
+    disconnect(m_frameClock, SIGNAL(tick()), this, SLOT(onTick()));
 }
 
-bool BobClient::connectToBoblight()
+void BobClient::connectToBoblight()
 {
-    if (connected()) {
-        return true;
+    if (connected() || m_backend->connecting()) {
+        return;
+    }
+    if (m_connectAttempts++ > 0) {
+        m_reconnectAttempts++;
     }
-    m_boblight = boblight_init();
+    m_backend->connectToServer(m_host, m_port, m_priority);
+}
 
-    //try to connect, if we can't then bitch to stderr and destroy boblight
-    if (!boblight_connect(m_boblight, m_host.toLatin1().data(), m_port, 1000000)) {
-        qCWarning(dcBoblight) << "Failed to connect:" << boblight_geterror(m_boblight);
-        boblight_destroy(m_boblight);
-        m_boblight = nullptr;
-        setConnected(false);
-        return false;
+void BobClient::onConnectFinished(bool success)
+{
+    if (!success) {
+        qCWarning(dcBoblight) << "Failed to connect:" << m_backend->errorString() << "Retrying in" << m_reconnectDelay << "ms";
+        scheduleReconnect(m_reconnectDelay);
+        emit connectFinished(false);
+        return;
     }
 
     qCDebug(dcBoblight) << "Connected to boblightd successfully.";
-    boblight_setpriority(m_boblight, m_priority);
-    for (int i = 0; i < lightsCount(); ++i) {
-        BobChannel *channel = new BobChannel(i, this);
-        channel->setColor(QColor(255,255,255,0));
-        connect(channel, SIGNAL(colorChanged()), this, SLOT(sync()));
-        m_channels.insert(i, channel);
+
+    // Channels survive disconnects, only adapt them if boblightd's configuration changed
+    int count = lightsCount();
+    while (m_channels.count() > count) {
+        delete m_channels.take(m_channels.lastKey());
+    }
+    m_frame.fill(0, count * 3);
+    m_animator.resize(count);
+    m_effects.resize(count);
+    m_compositor.resize(count);
+    m_streamFrame.fill(0, count * 3);
+    if (m_streamInput) {
+        m_streamInput->setFrameSize(count * 3);
+    }
+    for (int i = 0; i < count; ++i) {
+        BobChannel *channel = m_channels.value(i);
+        if (!channel) {
+            channel = new BobChannel(i, this);
+            channel->setColor(QColor(255,255,255,0));
+            m_channels.insert(i, channel);
+        }
+        m_animator.startTransition(i, channel->target().rgba());
     }
     setConnected(true);
-    return true;
+
+    // Whatever has been restored while handling connectionChanged() goes out in a single frame
+    m_animator.finishTransitions();
+    emit connectFinished(true);
+}
+
+void BobClient::reconnectNow()
+{
+    if (connected()) {
+        return;
+    }
+    m_reconnectDelay = minimumReconnectDelay;
+    m_reconnectTimer->stop();
+    connectToBoblight();
+}
+
+void BobClient::scheduleReconnect(int delay)
+{
+    // +-20% jitter so servers which went away together don't come back in lockstep
+    int jitter = delay / 5;
+    if (jitter > 0) {
+        delay += randomJitter(2 * jitter + 1) - jitter;
+    }
+    m_reconnectTimer->start(delay);
+    m_reconnectDelay = qMin(m_reconnectDelay * 2, maximumReconnectDelay);
 }
 
 bool BobClient::connected()
@@ -84,52 +191,250 @@ void BobClient::setPriority(int priority)
 {
     m_priority = priority;
     if (connected()) {
-        qCDebug(dcBoblight) << "setting priority to" << priority << boblight_setpriority(m_boblight, priority);
+        m_backend->setPriority(priority);
     }
     emit priorityChanged(priority);
 }
 
-void BobClient::setPower(int channel, bool power)
+void BobClient::setKeepAliveInterval(int seconds)
+{
+    if (seconds <= 0) {
+        m_keepAliveTimer->stop();
+        m_keepAliveTimer->setInterval(0);
+        return;
+    }
+
+    m_keepAliveTimer->setInterval(seconds * 1000);
+    if (connected()) {
+        m_keepAliveTimer->start();
+    }
+}
+
+int BobClient::frameRate() const
+{
+    return m_frameRate;
+}
+
+void BobClient::setFrameRate(int framesPerSecond)
+{
+    // A shared clock runs at the rate its owner picked
+    m_frameRate = framesPerSecond;
+    m_ownFrameClock->setFrameRate(framesPerSecond);
+}
+
+void BobClient::setFrameClock(BobFrameClock *frameClock)
+{
+    if (!frameClock) {
+        frameClock = m_ownFrameClock;
+    }
+    if (frameClock == m_frameClock) {
+        return;
+    }
+
+    bool ticking = m_ticking;
+    setTicking(false);
+    disconnect(m_frameClock, SIGNAL(tick()), this, SLOT(onTick()));
+    m_frameClock = frameClock;
+    connect(m_frameClock, SIGNAL(tick()), this, SLOT(onTick()));
+    setTicking(ticking);
+}
+
+void BobClient::setOutputCurve(BobOutputStage::Curve curve, double gamma)
+{
+    m_outputStage.setCurve(curve, gamma);
+    scheduleFrame();
+}
+
+void BobClient::setDithering(bool dithering)
+{
+    m_outputStage.setDithering(dithering);
+    scheduleFrame();
+}
+
+void BobClient::setOverride(int firstChannel, int lastChannel, const QColor &color)
+{
+    // Overrides sit on the top layer, the channels below keep their state
+    QRgb *pixels = m_compositor.pixels(BobCompositor::LayerOverride);
+    QRgb pixel = BobCompositor::premultiplied(color.rgba());
+    for (int i = qMax(0, firstChannel); i <= lastChannel && i < m_compositor.count(); ++i) {
+        pixels[i] = pixel;
+    }
+    m_compositor.setEnabled(BobCompositor::LayerOverride, true);
+    scheduleFrame();
+}
+
+void BobClient::clearOverride(int firstChannel, int lastChannel)
+{
+    QRgb *pixels = m_compositor.pixels(BobCompositor::LayerOverride);
+    bool overridden = false;
+    for (int i = 0; i < m_compositor.count(); ++i) {
+        if (i >= firstChannel && i <= lastChannel) {
+            pixels[i] = 0;
+        }
+        overridden |= pixels[i] != 0;
+    }
+    m_compositor.setEnabled(BobCompositor::LayerOverride, overridden);
+    scheduleFrame();
+}
+
+void BobClient::setLayer(BobCompositor::Layer layer, int opacity, BobCompositor::BlendMode blendMode)
+{
+    m_compositor.setOpacity(layer, opacity);
+    m_compositor.setBlendMode(layer, blendMode);
+    scheduleFrame();
+}
+
+bool BobClient::startRecording(const QString &fileName)
+{
+    if (!m_recorder.start(fileName, lightsCount())) {
+        qCWarning(dcBoblight) << "Could not record to" << fileName << m_recorder.errorString();
+        return false;
+    }
+    qCDebug(dcBoblight) << "Recording frames to" << fileName;
+    return true;
+}
+
+void BobClient::stopRecording()
+{
+    m_recorder.stop();
+}
+
+bool BobClient::startPlayback(const QString &fileName, bool loop)
+{
+    if (!m_player) {
+        m_player = new BobPlayer(this);
+        connect(m_player, SIGNAL(frameAvailable()), this, SLOT(onPlaybackFrame()));
+        // Once done the channels take over again
+        connect(m_player, SIGNAL(finished()), this, SLOT(scheduleFrame()));
+    }
+    if (!m_player->open(fileName)) {
+        qCWarning(dcBoblight) << "Could not play" << fileName << m_player->errorString();
+        return false;
+    }
+    if (m_player->lightsCount() != lightsCount()) {
+        qCWarning(dcBoblight) << "Playing a recording of" << m_player->lightsCount() << "lights on" << lightsCount() << "lights";
+    }
+    m_player->play(loop);
+    return true;
+}
+
+void BobClient::stopPlayback()
+{
+    if (m_player) {
+        m_player->close();
+        scheduleFrame();
+    }
+}
+
+bool BobClient::setStreamSocket(const QString &path)
+{
+    if (path.isEmpty()) {
+        delete m_streamInput;
+        m_streamInput = nullptr;
+        return true;
+    }
+
+    if (!m_streamInput) {
+        m_streamInput = new BobStreamInput(this);
+        m_streamInput->setFrameSize(m_frame.size());
+        connect(m_streamInput, SIGNAL(frameAvailable()), this, SLOT(scheduleFrame()));
+        // Going stale hands the lights back to the channels
+        connect(m_streamInput, SIGNAL(activeChanged(bool)), this, SLOT(scheduleFrame()));
+    }
+    return m_streamInput->listen(path);
+}
+
+void BobClient::startEffect(BobEffectEngine::Effect effect, const QColor &color, int speed, int firstChannel, int lastChannel)
+{
+    qCDebug(dcBoblight) << "Starting effect" << effect << "on channels" << firstChannel << "to" << lastChannel;
+    m_effects.start(effect, color.rgba(), speed, firstChannel, lastChannel, m_clock.elapsed());
+    scheduleFrame();
+}
+
+void BobClient::stopEffect()
+{
+    m_effects.stop();
+    // One more frame to bring back the channel colors
+    scheduleFrame();
+}
+
+BobFrameClock *BobClient::frameClock() const
+{
+    return m_frameClock;
+}
+
+void BobClient::setPower(int channel, bool power, int duration, BobAnimator::Easing easing)
 {
     qCDebug(dcBoblight()) << "BobClient: setPower" << channel << power;
-    m_channels.value(channel)->setPower(power);
+    BobChannel *c = getChannel(channel);
+    if (!c) {
+        return;
+    }
+    c->setPower(power);
+    startTransition(c, duration, easing);
     emit powerChanged(channel, power);
 }
 
 BobChannel *BobClient::getChannel(const int &id)
 {
-    foreach (BobChannel *channel, m_channels) {
-        if (channel->id() == id)
-            return channel;
-    }
-    return 0;
+    return m_channels.value(id);
 }
 
-void BobClient::setColor(int channel, QColor color)
+
+void BobClient::setColor(int channel, QColor color, int duration, BobAnimator::Easing easing)
 {    
     if (channel == -1) {
         for (int i = 0; i < lightsCount(); ++i) {
-            setColor(i, color);
+            setColor(i, color, duration, easing);
         }
     } else {
         BobChannel *c = getChannel(channel);
         if (c) {
             c->setColor(color);
+            startTransition(c, duration, easing);
             qCDebug(dcBoblight) << "set channel" << channel << "to color" << color;
             emit colorChanged(channel, color);
         }
     }
 }
 
-void BobClient::setBrightness(int channel, int brightness)
+void BobClient::setColors(int firstChannel, const QList<QColor> &colors, int duration, BobAnimator::Easing easing)
 {
-    QColor color = m_channels.value(channel)->color();
+    // All transitions requested here start on the same frame
+    qCDebug(dcBoblight) << "set" << colors.count() << "channels starting at" << firstChannel;
+    for (int i = 0; i < colors.count(); ++i) {
+        BobChannel *c = getChannel(firstChannel + i);
+        if (c) {
+            c->setColor(colors.at(i));
+            startTransition(c, duration, easing);
+            emit colorChanged(firstChannel + i, colors.at(i));
+        }
+    }
+}
+
+void BobClient::setTransition(int msecs, BobAnimator::Easing easing)
+{
+    m_animator.setDuration(msecs);
+    m_animator.setEasing(easing);
+}
+
+void BobClient::setBrightness(int channel, int brightness, int duration, BobAnimator::Easing easing)
+{
+    BobChannel *c = getChannel(channel);
+    if (!c) {
+        return;
+    }
+
+    QColor color = c->color();
     color.setAlpha(qRound(brightness * 255.0 / 100));
-    m_channels.value(channel)->setColor(color);
-    emit brightnessChanged(channel, brightness);
+    c->setColor(color);
+    if (brightness > 0) {
+        c->setPower(true);
+    }
+    startTransition(c, duration, easing);
 
+    emit brightnessChanged(channel, brightness);
     if (brightness > 0) {
-        m_channels.value(channel)->setPower(true);
         emit powerChanged(channel, true);
     }
 }
@@ -139,20 +444,132 @@ void BobClient::sync()
     if (!m_connected)
         return;
 
-    foreach (BobChannel *channel, m_channels) {
-        int rgb[3];
-        rgb[0] = channel->finalColor().red() * channel->finalColor().alphaF();
-        rgb[1] = channel->finalColor().green() * channel->finalColor().alphaF();
-        rgb[2] = channel->finalColor().blue() * channel->finalColor().alphaF();
-        boblight_addpixel(m_boblight, channel->id(), rgb);
+    qint64 now = m_clock.elapsed();
+    bool animating = m_animator.advance(now);
+
+    bool dithering = false;
+    bool streamed = false;
+    if (m_player && m_player->playing()) {
+        // Playback sends its frames on its own timing, in between the last one is repeated
+    } else {
+        // Streamed frames stay on their layer until the next one comes in
+        bool streaming = m_streamInput && m_streamInput->active();
+        if (streaming && m_streamInput->takeFrame(reinterpret_cast<quint8 *>(m_streamFrame.data()))) {
+            m_compositor.setPixels(BobCompositor::LayerStream, reinterpret_cast<const quint8 *>(m_streamFrame.constData()));
+            streamed = true;
+        }
+        m_compositor.setEnabled(BobCompositor::LayerStream, streaming);
+
+        if (m_effects.running()) {
+            m_effects.render(now, m_compositor.pixels(BobCompositor::LayerEffect));
+        }
+        m_compositor.setEnabled(BobCompositor::LayerEffect, m_effects.running());
+
+        const QRgb *values = m_compositor.composite(m_animator.values());
+        dithering = m_outputStage.process(values, reinterpret_cast<quint8 *>(m_frame.data()), m_animator.count());
     }
 
-    if (!boblight_sendrgb(m_boblight, 1, NULL)) {
-        qCWarning(dcBoblight) << "Boblight connection error:" << boblight_geterror(m_boblight);
-        boblight_destroy(m_boblight);
-        qDeleteAll(m_channels);
-        m_channels.clear();
-        setConnected(false);
+    if (!sendFrame()) {
+        return;
+    }
+
+    // The last frame of a transition went out, nothing left to do until the next state change.
+    // Dithered levels keep the clock running until they settle on whole output levels.
+    if (!animating && !dithering && !streamed && !m_effects.running() && m_ticking) {
+        setTicking(false);
+        qCDebug(dcBoblight) << "Frame clock idle." << m_frameClock->frames() << "frames," << m_frameClock->missedDeadlines() << "missed deadlines, jitter avg" << m_frameClock->averageJitter() << "us, max" << m_frameClock->maximumJitter() << "us";
+    }
+}
+
+bool BobClient::sendFrame()
+{
+    if (!m_backend->sendFrame(reinterpret_cast<const quint8 *>(m_frame.constData()))) {
+        qCWarning(dcBoblight) << "Boblight connection error:" << m_backend->errorString();
+        connectionLost();
+        return false;
+    }
+
+    if (m_recorder.recording() && m_recorder.lightsCount() * 3 == m_frame.size()) {
+        m_recorder.record(m_clock.elapsed(), reinterpret_cast<const quint8 *>(m_frame.constData()));
+    }
+
+    if (m_keepAliveTimer->interval() > 0) {
+        m_keepAliveTimer->start();
+    }
+    return true;
+}
+
+void BobClient::onKeepAlive()
+{
+    if (!m_connected || m_backend->ping()) {
+        return;
+    }
+    sync();
+}
+
+void BobClient::onPlaybackFrame()
+{
+    if (m_connected && m_player->takeFrame(reinterpret_cast<quint8 *>(m_frame.data()), m_frame.size())) {
+        sendFrame();
+    }
+}
+
+void BobClient::onDisconnected()
+{
+    qCWarning(dcBoblight) << "Boblight connection error:" << m_backend->errorString();
+    connectionLost();
+}
+
+void BobClient::connectionLost()
+{
+    bool stable = m_connected && m_connectedSince.elapsed() >= stableConnectionTime;
+    m_backend->disconnectFromServer();
+    setConnected(false);
+
+    // After a while without problems most likely boblightd has been restarted, try again
+    // right away. A server dropping us again shortly after connecting gets the backoff.
+    if (stable) {
+        m_reconnectDelay = minimumReconnectDelay;
+        m_reconnectTimer->start(0);
+    } else {
+        qCWarning(dcBoblight) << "Connection dropped shortly after connecting. Retrying in" << m_reconnectDelay << "ms";
+        scheduleReconnect(m_reconnectDelay);
+    }
+}
+
+void BobClient::startTransition(BobChannel *channel, int duration, BobAnimator::Easing easing)
+{
+    m_animator.startTransition(channel->id(), channel->target().rgba(), duration, easing);
+    scheduleFrame();
+}
+
+void BobClient::scheduleFrame()
+{
+    // The next tick picks up all changes made until then. If the clock isn't running
+    // yet, its first tick comes once the current burst of changes is done.
+    if (m_connected) {
+        setTicking(true);
+    }
+}
+
+void BobClient::setTicking(bool ticking)
+{
+    if (ticking == m_ticking) {
+        return;
+    }
+    m_ticking = ticking;
+    if (ticking) {
+        m_frameClock->acquire();
+    } else {
+        m_frameClock->release();
+    }
+}
+
+void BobClient::onTick()
+{
+    // A shared clock keeps ticking while any of its clients has frames to send
+    if (m_ticking) {
+        sync();
     }
 }
 
@@ -161,21 +578,63 @@ void BobClient::setConnected(bool connected)
     m_connected = connected;
     emit connectionChanged();
 
-    // if disconnected, delete all channels
     if (!connected) {
-        m_syncTimer->stop();
-        qDeleteAll(m_channels);
+        setTicking(false);
+        m_keepAliveTimer->stop();
+        m_metricsTimer->stop();
     } else {
-        m_syncTimer->start();
+        m_connectedSince.start();
+        m_metricsTimer->start();
+        scheduleFrame();
+    }
+    emit metricsChanged();
+}
+
+quint64 BobClient::framesSent() const
+{
+    return m_backend->framesWritten();
+}
+
+quint64 BobClient::framesSkipped() const
+{
+    return m_backend->framesSkipped() + (m_streamInput ? m_streamInput->framesDropped() : 0);
+}
+
+quint64 BobClient::bytesWritten() const
+{
+    return m_backend->bytesWritten();
+}
+
+bool BobClient::countsBytesWritten() const
+{
+    return m_backend->countsBytesWritten();
+}
+
+double BobClient::sendLatency(int percentile) const
+{
+    return m_backend->sendLatency(percentile);
+}
+
+int BobClient::reconnectAttempts() const
+{
+    return m_reconnectAttempts;
+}
+
+int BobClient::uptime() const
+{
+    if (!m_connected) {
+        return 0;
     }
+    return m_connectedSince.elapsed() / 1000;
 }
 
 int BobClient::lightsCount()
 {
-    return boblight_getnrlights(m_boblight);
+    return m_backend->lightsCount();
 }
 
 QColor BobClient::currentColor(const int &channel)
 {
-    return getChannel(channel)->color();
+    BobChannel *c = getChannel(channel);
+    return c ? c->color() : QColor();
 }
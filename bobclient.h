@@ -27,32 +27,102 @@
 #include <QMap>
 #include <QColor>
 #include <QTime>
+#include <QByteArray>
+#include <QVector>
+#include <QElapsedTimer>
 
 #include <bobchannel.h>
+#include <bobanimator.h>
+#include <boboutputstage.h>
+#include <bobframeclock.h>
+#include <bobeffectengine.h>
+#include <bobcompositor.h>
+#include <bobstreaminput.h>
+#include <bobrecording.h>
+
+class BobBackend;
 
 class BobClient : public QObject
 {
     Q_OBJECT
 public:
-    explicit BobClient(const QString &host = "127.0.0.1", const int &port = 19333, QObject *parent = 0);
+    enum Protocol {
+        ProtocolLibBoblight,
+        ProtocolNative
+    };
+
+    explicit BobClient(const QString &host = "127.0.0.1", const int &port = 19333, Protocol protocol = ProtocolLibBoblight, QObject *parent = 0);
     ~BobClient();
 
-    bool connectToBoblight();
     bool connected();
 
     int lightsCount();
     QColor currentColor(const int &channel);
 
     void setPriority(int priority);
-
-    void setPower(int channel, bool power);
-    void setColor(int channel, QColor color);
-    void setBrightness(int channel, int brightness);
+    void setKeepAliveInterval(int seconds);
+
+    int frameRate() const;
+    void setFrameRate(int framesPerSecond);
+    BobFrameClock *frameClock() const;
+    // Lets several clients send their frames on the same ticks, 0 goes back to the own clock
+    void setFrameClock(BobFrameClock *frameClock);
+
+    void setOutputCurve(BobOutputStage::Curve curve, double gamma = 2.2);
+    void setDithering(bool dithering);
+
+    void startEffect(BobEffectEngine::Effect effect, const QColor &color, int speed, int firstChannel = 0, int lastChannel = -1);
+    void stopEffect();
+
+    // Fixed colors on top of everything else for a channel range, until cleared again
+    void setOverride(int firstChannel, int lastChannel, const QColor &color);
+    void clearOverride(int firstChannel, int lastChannel);
+    // opacity is 0..255
+    void setLayer(BobCompositor::Layer layer, int opacity, BobCompositor::BlendMode blendMode);
+
+    // Raw frames from a local producer cover the channels and effects while they keep coming
+    bool setStreamSocket(const QString &path);
+
+    // Records every frame sent to boblightd, playback takes precedence over all other sources
+    bool startRecording(const QString &fileName);
+    void stopRecording();
+    bool startPlayback(const QString &fileName, bool loop = false);
+    void stopPlayback();
+
+    // Runtime metrics. Frames sent are the ones actually written to boblightd, send latency
+    // is the time from writing a frame until it left (native) or boblight_sendrgb() returned.
+    quint64 framesSent() const;
+    quint64 framesSkipped() const;
+    quint64 bytesWritten() const;
+    bool countsBytesWritten() const;
+    double sendLatency(int percentile) const;
+    int reconnectAttempts() const;
+    int uptime() const;
+
+    // Without a duration/easing the defaults from setTransition() are used
+    void setPower(int channel, bool power, int duration = -1, BobAnimator::Easing easing = BobAnimator::EasingDefault);
+    void setColor(int channel, QColor color, int duration = -1, BobAnimator::Easing easing = BobAnimator::EasingDefault);
+    void setColors(int firstChannel, const QList<QColor> &colors, int duration = -1, BobAnimator::Easing easing = BobAnimator::EasingDefault);
+    void setBrightness(int channel, int brightness, int duration = -1, BobAnimator::Easing easing = BobAnimator::EasingDefault);
+
+    void setTransition(int msecs, BobAnimator::Easing easing);
+
+public slots:
+    void connectToBoblight();
+    // Skips a pending backoff delay, e.g. when the network came back
+    void reconnectNow();
 
 private:
-    void *m_boblight = nullptr;
-
-    QTimer *m_syncTimer;
+    BobBackend *m_backend = nullptr;
+
+    BobFrameClock *m_frameClock;
+    BobFrameClock *m_ownFrameClock;
+    int m_frameRate = 20;
+    bool m_ticking = false;
+    QTimer *m_keepAliveTimer;
+    QTimer *m_metricsTimer;
+    QTimer *m_reconnectTimer;
+    int m_reconnectDelay = 1000;
     QString m_host;
     int m_port;
     bool m_connected;
@@ -60,20 +130,47 @@ private:
 
     QMap<int, QColor> m_colors;
     QMap<int, BobChannel *> m_channels;
+    QByteArray m_frame;
+
+    QElapsedTimer m_clock;
+    BobAnimator m_animator;
+    BobOutputStage m_outputStage;
+    BobEffectEngine m_effects;
+    BobCompositor m_compositor;
+    BobStreamInput *m_streamInput = nullptr;
+    QByteArray m_streamFrame;
+    BobRecorder m_recorder;
+    BobPlayer *m_player = nullptr;
+
+    int m_connectAttempts = 0;
+    int m_reconnectAttempts = 0;
+    QElapsedTimer m_connectedSince;
 
     BobChannel *getChannel(const int &id);
-
+    void startTransition(BobChannel *channel, int duration, BobAnimator::Easing easing);
+    void connectionLost();
+    void scheduleReconnect(int delay);
+    void setTicking(bool ticking);
+    bool sendFrame();
 
 private slots:
+    void onConnectFinished(bool success);
+    void onDisconnected();
     void sync();
+    void onTick();
+    void onKeepAlive();
+    void onPlaybackFrame();
+    void scheduleFrame();
     void setConnected(bool connected);
 
 signals:
     void connectionChanged();
+    void connectFinished(bool success);
     void powerChanged(int channel, bool power);
     void brightnessChanged(int channel, int brightness);
     void colorChanged(int channel, const QColor &color);
     void priorityChanged(int priority);
+    void metricsChanged();
 };
 
 #endif // BOBCLIENT_H
@@ -0,0 +1,71 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobcolortemperature.h"
+
+// Planck's law integrated against the CIE 1931 2° observer, converted to sRGB,
+// normalized to the brightest component and gamma encoded. Sampled in equal mired
+// steps, which are roughly equal perceptual steps, so linear interpolation between
+// neighbours stays within one level of the exact curve.
+static const int tableSteps = 20;
+static const QRgb blackbodyTable[tableSteps + 1] = {
+    qRgb(255, 249, 255), // 153.0 mired, 6536 K
+    qRgb(255, 242, 237), // 170.3 mired, 5870 K
+    qRgb(255, 235, 220), // 187.7 mired, 5328 K
+    qRgb(255, 229, 203), // 205.1 mired, 4877 K
+    qRgb(255, 222, 188), // 222.4 mired, 4496 K
+    qRgb(255, 216, 174), // 239.8 mired, 4171 K
+    qRgb(255, 210, 160), // 257.1 mired, 3890 K
+    qRgb(255, 204, 147), // 274.4 mired, 3644 K
+    qRgb(255, 198, 135), // 291.8 mired, 3427 K
+    qRgb(255, 192, 124), // 309.1 mired, 3235 K
+    qRgb(255, 187, 114), // 326.5 mired, 3063 K
+    qRgb(255, 182, 103), // 343.9 mired, 2908 K
+    qRgb(255, 177,  94), // 361.2 mired, 2769 K
+    qRgb(255, 172,  85), // 378.6 mired, 2642 K
+    qRgb(255, 167,  76), // 395.9 mired, 2526 K
+    qRgb(255, 162,  67), // 413.2 mired, 2420 K
+    qRgb(255, 158,  58), // 430.6 mired, 2322 K
+    qRgb(255, 153,  50), // 447.9 mired, 2232 K
+    qRgb(255, 149,  41), // 465.3 mired, 2149 K
+    qRgb(255, 145,  32), // 482.6 mired, 2072 K
+    qRgb(255, 141,  21), // 500.0 mired, 2000 K
+};
+
+QRgb BobColorTemperature::toRgb(int temperature)
+{
+    if (temperature <= minimum) {
+        return blackbodyTable[0];
+    }
+    if (temperature >= maximum) {
+        return blackbodyTable[tableSteps];
+    }
+
+    // Position in the table in 1/256 steps
+    int position = (temperature - minimum) * tableSteps * 256 / (maximum - minimum);
+    int index = position >> 8;
+    int fraction = position & 0xff;
+
+    QRgb a = blackbodyTable[index];
+    QRgb b = blackbodyTable[index + 1];
+    return qRgb(qRed(a) + (((qRed(b) - qRed(a)) * fraction + 128) >> 8),
+                qGreen(a) + (((qGreen(b) - qGreen(a)) * fraction + 128) >> 8),
+                qBlue(a) + (((qBlue(b) - qBlue(a)) * fraction + 128) >> 8));
+}
@@ -0,0 +1,156 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobcompositor.h"
+
+// value * factor / 255 rounded, exact for value, factor in 0..255
+static inline uint mul(uint value, uint factor)
+{
+    uint t = value * factor + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// Exact floor(value * alpha / 255), the same as BobOutputStage
+static inline uint premultiply(uint value, uint alpha)
+{
+    uint t = value * alpha;
+    return (t + 1 + (t >> 8)) >> 8;
+}
+
+BobCompositor::BobCompositor()
+{
+}
+
+void BobCompositor::resize(int count)
+{
+    // Layers survive reconnects like the channels do, added lights start out transparent
+    for (int i = 0; i < LayerCount; ++i) {
+        m_layers[i].pixels.resize(count);
+    }
+    m_output.resize(count);
+}
+
+int BobCompositor::count() const
+{
+    return m_output.count();
+}
+
+QRgb *BobCompositor::pixels(Layer layer)
+{
+    return m_layers[layer].pixels.data();
+}
+
+void BobCompositor::setPixels(Layer layer, const quint8 *rgb)
+{
+    QRgb *pixels = m_layers[layer].pixels.data();
+    for (int i = 0; i < m_output.count(); ++i) {
+        pixels[i] = qRgb(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+    }
+}
+
+bool BobCompositor::enabled(Layer layer) const
+{
+    return m_layers[layer].enabled;
+}
+
+void BobCompositor::setEnabled(Layer layer, bool enabled)
+{
+    m_layers[layer].enabled = enabled;
+}
+
+int BobCompositor::opacity(Layer layer) const
+{
+    return m_layers[layer].opacity;
+}
+
+void BobCompositor::setOpacity(Layer layer, int opacity)
+{
+    m_layers[layer].opacity = qBound(0, opacity, 255);
+}
+
+BobCompositor::BlendMode BobCompositor::blendMode(Layer layer) const
+{
+    return m_layers[layer].blendMode;
+}
+
+void BobCompositor::setBlendMode(Layer layer, BlendMode blendMode)
+{
+    m_layers[layer].blendMode = blendMode;
+}
+
+const QRgb *BobCompositor::composite(const QRgb *base)
+{
+    int layers = 0;
+    for (int i = 0; i < LayerCount; ++i) {
+        if (m_layers[i].enabled && m_layers[i].opacity > 0) {
+            layers++;
+        }
+    }
+    if (layers == 0) {
+        return base;
+    }
+
+    QRgb *output = m_output.data();
+    int count = m_output.count();
+    for (int i = 0; i < count; ++i) {
+        output[i] = premultiplied(base[i]) | 0xff000000;
+    }
+
+    for (int l = 0; l < LayerCount; ++l) {
+        const LayerState &layer = m_layers[l];
+        if (!layer.enabled || layer.opacity == 0) {
+            continue;
+        }
+        const QRgb *pixels = layer.pixels.constData();
+        uint opacity = layer.opacity;
+        for (int i = 0; i < count; ++i) {
+            uint alpha = mul(qAlpha(pixels[i]), opacity);
+            if (alpha == 0) {
+                continue;
+            }
+            uint source[3] = { mul(qRed(pixels[i]), opacity), mul(qGreen(pixels[i]), opacity), mul(qBlue(pixels[i]), opacity) };
+            uint dest[3] = { uint(qRed(output[i])), uint(qGreen(output[i])), uint(qBlue(output[i])) };
+            for (int c = 0; c < 3; ++c) {
+                switch (layer.blendMode) {
+                case BlendNormal:
+                    dest[c] = source[c] + mul(dest[c], 255 - alpha);
+                    break;
+                case BlendAdd:
+                    dest[c] = qMin(255u, dest[c] + source[c]);
+                    break;
+                case BlendMultiply:
+                    dest[c] = mul(dest[c], 255 - alpha) + mul(dest[c], source[c]);
+                    break;
+                case BlendScreen:
+                    dest[c] = dest[c] + source[c] - mul(dest[c], source[c]);
+                    break;
+                }
+            }
+            output[i] = qRgb(qMin(255u, dest[0]), qMin(255u, dest[1]), qMin(255u, dest[2]));
+        }
+    }
+    return output;
+}
+
+QRgb BobCompositor::premultiplied(QRgb color)
+{
+    uint alpha = qAlpha(color);
+    return qRgba(premultiply(qRed(color), alpha), premultiply(qGreen(color), alpha), premultiply(qBlue(color), alpha), alpha);
+}
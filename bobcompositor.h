@@ -0,0 +1,84 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBCOMPOSITOR_H
+#define BOBCOMPOSITOR_H
+
+#include <QRgb>
+#include <QVector>
+
+// Stacks a fixed set of layers on top of the animated channel colors of a BobClient.
+// Layer pixels are premultiplied, their alpha says how much of a channel the layer
+// covers. Layers are only written when their source changes, compositing them is a
+// single integer pass per frame.
+class BobCompositor
+{
+public:
+    // Bottom to top, the animated channels are below all of them
+    enum Layer {
+        LayerEffect,
+        LayerStream,
+        LayerOverride,
+        LayerCount
+    };
+
+    enum BlendMode {
+        BlendNormal,
+        BlendAdd,
+        BlendMultiply,
+        BlendScreen
+    };
+
+    BobCompositor();
+
+    // Keeps the pixels of the lights which are still there
+    void resize(int count);
+    int count() const;
+
+    QRgb *pixels(Layer layer);
+    // Sets all pixels of the layer to the opaque colors given as 3 bytes per light
+    void setPixels(Layer layer, const quint8 *rgb);
+
+    bool enabled(Layer layer) const;
+    void setEnabled(Layer layer, bool enabled);
+    int opacity(Layer layer) const;
+    void setOpacity(Layer layer, int opacity);
+    BlendMode blendMode(Layer layer) const;
+    void setBlendMode(Layer layer, BlendMode blendMode);
+
+    // base holds straight ARGB with the brightness in the alpha channel. Without any
+    // enabled layer base is returned as it is, otherwise the composited opaque frame.
+    const QRgb *composite(const QRgb *base);
+
+    static QRgb premultiplied(QRgb color);
+
+private:
+    struct LayerState {
+        QVector<QRgb> pixels;
+        bool enabled = false;
+        uint opacity = 255;
+        BlendMode blendMode = BlendNormal;
+    };
+
+    LayerState m_layers[LayerCount];
+    QVector<QRgb> m_output;
+};
+
+#endif // BOBCOMPOSITOR_H
@@ -0,0 +1,149 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobeffectengine.h"
+#include "bobcompositor.h"
+
+#include <qmath.h>
+#include <string.h>
+
+BobEffectEngine::BobEffectEngine()
+{
+    // 0..255 over one period, starting at the minimum
+    for (int i = 0; i < 256; ++i) {
+        m_sine[i] = qRound((1 - qCos(i * 2 * M_PI / 256)) * 127.5);
+    }
+}
+
+void BobEffectEngine::resize(int count)
+{
+    m_flicker.fill(255, count);
+    m_flickerTarget.fill(255, count);
+}
+
+void BobEffectEngine::start(Effect effect, QRgb color, int speed, int firstChannel, int lastChannel, qint64 now)
+{
+    m_effect = effect;
+    m_color = color;
+    m_speed = qBound(1, speed, 100);
+    m_first = qMax(0, firstChannel);
+    m_last = lastChannel;
+    m_startTime = now;
+}
+
+void BobEffectEngine::stop()
+{
+    m_effect = EffectNone;
+}
+
+BobEffectEngine::Effect BobEffectEngine::effect() const
+{
+    return m_effect;
+}
+
+bool BobEffectEngine::running() const
+{
+    return m_effect != EffectNone;
+}
+
+void BobEffectEngine::render(qint64 now, QRgb *pixels)
+{
+    int count = m_flicker.count();
+    memset(pixels, 0, count * sizeof(QRgb));
+    int last = m_last < 0 || m_last >= count ? count - 1 : m_last;
+    if (m_effect == EffectNone || m_first > last) {
+        return;
+    }
+
+    // Position within the current cycle in 1/65536
+    uint phase = ((now - m_startTime) * m_speed * 65536 / 60000) & 0xffff;
+    int span = last - m_first + 1;
+
+    switch (m_effect) {
+    case EffectNone:
+        break;
+    case EffectRainbow:
+        for (int i = m_first; i <= last; ++i) {
+            pixels[i] = hue(((phase >> 8) + (i - m_first) * 256 / span) & 0xff);
+        }
+        break;
+    case EffectBreathing: {
+        QRgb color = scale(m_color, m_sine[phase >> 8]);
+        for (int i = m_first; i <= last; ++i) {
+            pixels[i] = color;
+        }
+        break;
+    }
+    case EffectChase: {
+        // Head position in 1/256 channels, followed by a tail of a quarter of the range
+        qint64 head = qint64(phase) * span >> 8;
+        int tail = qMax(1, span / 4) << 8;
+        for (int i = m_first; i <= last; ++i) {
+            int distance = int((head - ((i - m_first) << 8)) % (span << 8));
+            if (distance < 0) {
+                distance += span << 8;
+            }
+            pixels[i] = distance < tail ? scale(m_color, 255 - distance * 255 / tail) : qRgb(0, 0, 0);
+        }
+        break;
+    }
+    case EffectCandle:
+        // Every light wanders towards a random target, faster speeds pick new targets more often
+        for (int i = m_first; i <= last; ++i) {
+            if (int(random() % 100) < m_speed) {
+                m_flickerTarget[i] = 140 + random() % 116;
+            }
+            m_flicker[i] += (m_flickerTarget[i] - m_flicker[i]) / 4;
+            pixels[i] = scale(m_color, m_flicker[i]);
+        }
+        break;
+    }
+}
+
+quint32 BobEffectEngine::random()
+{
+    // xorshift32, plenty for flicker and doesn't touch any shared state
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+QRgb BobEffectEngine::hue(uint hue)
+{
+    // Fully saturated hue in 6 sectors of ~43 steps
+    uint sector = hue * 6 / 256;
+    uint rise = (hue * 6 - sector * 256);
+    uint fall = 255 - rise;
+    switch (sector) {
+    case 0: return qRgb(255, rise, 0);
+    case 1: return qRgb(fall, 255, 0);
+    case 2: return qRgb(0, 255, rise);
+    case 3: return qRgb(0, fall, 255);
+    case 4: return qRgb(rise, 0, 255);
+    default: return qRgb(255, 0, fall);
+    }
+}
+
+QRgb BobEffectEngine::scale(QRgb color, uint level)
+{
+    // Dimmed but opaque, the effect hides whatever is below it
+    return BobCompositor::premultiplied(qRgba(qRed(color), qGreen(color), qBlue(color), qAlpha(color) * level / 255)) | 0xff000000;
+}
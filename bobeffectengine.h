@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBEFFECTENGINE_H
+#define BOBEFFECTENGINE_H
+
+#include <QRgb>
+#include <QVector>
+
+// Procedural effects rendered by BobClient on every frame into a compositor layer.
+// All buffers are sized in resize(), rendering a frame doesn't allocate.
+class BobEffectEngine
+{
+public:
+    enum Effect {
+        EffectNone,
+        EffectRainbow,
+        EffectBreathing,
+        EffectChase,
+        EffectCandle
+    };
+
+    BobEffectEngine();
+
+    void resize(int count);
+
+    // speed is 1..100 cycles per minute, channels last < 0 means up to the last channel
+    void start(Effect effect, QRgb color, int speed, int firstChannel, int lastChannel, qint64 now);
+    void stop();
+
+    Effect effect() const;
+    bool running() const;
+
+    // Writes premultiplied pixels, opaque in the effect's channel range and transparent elsewhere
+    void render(qint64 now, QRgb *pixels);
+
+private:
+    Effect m_effect = EffectNone;
+    QRgb m_color = 0;
+    int m_speed = 20;
+    int m_first = 0;
+    int m_last = -1;
+    qint64 m_startTime = 0;
+    quint32 m_random = 0x9e3779b9;
+
+    QVector<quint8> m_flicker;
+    QVector<quint8> m_flickerTarget;
+    quint8 m_sine[256];
+
+    quint32 random();
+    static QRgb hue(uint hue);
+    static QRgb scale(QRgb color, uint level);
+};
+
+#endif // BOBEFFECTENGINE_H
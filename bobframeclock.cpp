@@ -0,0 +1,145 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobframeclock.h"
+
+BobFrameClock::BobFrameClock(QObject *parent) :
+    QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &BobFrameClock::onTimeout);
+
+    m_clock.start();
+}
+
+int BobFrameClock::frameRate() const
+{
+    return m_frameRate;
+}
+
+void BobFrameClock::setFrameRate(int framesPerSecond)
+{
+    m_frameRate = qBound(1, framesPerSecond, 1000);
+    m_interval = 1000000000LL / m_frameRate;
+    if (isActive()) {
+        m_nextDeadline = m_clock.nsecsElapsed() + m_interval;
+        scheduleNext();
+    }
+}
+
+bool BobFrameClock::isActive() const
+{
+    return m_timer->isActive();
+}
+
+quint64 BobFrameClock::frames() const
+{
+    return m_frames;
+}
+
+quint64 BobFrameClock::missedDeadlines() const
+{
+    return m_missedDeadlines;
+}
+
+qint64 BobFrameClock::averageJitter() const
+{
+    if (m_frames == 0) {
+        return 0;
+    }
+    return m_jitterSum / static_cast<qint64>(m_frames) / 1000;
+}
+
+qint64 BobFrameClock::maximumJitter() const
+{
+    return m_jitterMax / 1000;
+}
+
+void BobFrameClock::resetStatistics()
+{
+    m_frames = 0;
+    m_missedDeadlines = 0;
+    m_jitterSum = 0;
+    m_jitterMax = 0;
+}
+
+void BobFrameClock::acquire()
+{
+    if (m_users++ == 0) {
+        start();
+    }
+}
+
+void BobFrameClock::release()
+{
+    if (m_users > 0 && --m_users == 0) {
+        stop();
+    }
+}
+
+void BobFrameClock::start()
+{
+    if (isActive()) {
+        return;
+    }
+    // Changes made in the current event loop iteration go out together in the first frame
+    m_nextDeadline = m_clock.nsecsElapsed();
+    scheduleNext();
+}
+
+void BobFrameClock::stop()
+{
+    m_timer->stop();
+}
+
+void BobFrameClock::scheduleNext()
+{
+    // Round up, waking up early would just make us wait for the next round
+    qint64 remaining = m_nextDeadline - m_clock.nsecsElapsed();
+    m_timer->start(qMax<qint64>(0, (remaining + 999999) / 1000000));
+}
+
+void BobFrameClock::onTimeout()
+{
+    qint64 lateness = m_clock.nsecsElapsed() - m_nextDeadline;
+    if (lateness < 0) {
+        // The timer fired early, wait for the actual deadline
+        scheduleNext();
+        return;
+    }
+
+    m_frames++;
+    m_jitterSum += lateness;
+    m_jitterMax = qMax(m_jitterMax, lateness);
+
+    if (lateness >= m_interval) {
+        // Don't try to catch up with a burst of frames, continue on the next deadline in phase
+        qint64 missed = lateness / m_interval;
+        m_missedDeadlines += missed;
+        m_nextDeadline += missed * m_interval;
+    }
+    m_nextDeadline += m_interval;
+
+    // Schedule before emitting, tick() handlers may stop the clock
+    scheduleNext();
+    emit tick();
+}
@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBFRAMECLOCK_H
+#define BOBFRAMECLOCK_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Emits tick() at a fixed frame rate, the first one on the next event loop iteration
+// after starting. Deadlines are computed against a monotonic clock from the start time,
+// so timer inaccuracies don't add up. If a deadline is missed by more than a frame the
+// clock skips ahead to the next one in phase.
+//
+// A clock can be shared between several BobClients, each of them acquire()s it while it
+// has frames to send and release()s it again when idle.
+class BobFrameClock : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobFrameClock(QObject *parent = 0);
+
+    int frameRate() const;
+    void setFrameRate(int framesPerSecond);
+
+    bool isActive() const;
+
+    void acquire();
+    void release();
+
+    // Statistics since the last reset, times in microseconds
+    quint64 frames() const;
+    quint64 missedDeadlines() const;
+    qint64 averageJitter() const;
+    qint64 maximumJitter() const;
+    void resetStatistics();
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void tick();
+
+private:
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    int m_frameRate = 20;
+    qint64 m_interval = 50000000;
+    qint64 m_nextDeadline = 0;
+    int m_users = 0;
+
+    quint64 m_frames = 0;
+    quint64 m_missedDeadlines = 0;
+    qint64 m_jitterSum = 0;
+    qint64 m_jitterMax = 0;
+
+    void scheduleNext();
+
+private slots:
+    void onTimeout();
+};
+
+#endif // BOBFRAMECLOCK_H
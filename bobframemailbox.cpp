@@ -0,0 +1,68 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobframemailbox.h"
+
+BobFrameMailbox::BobFrameMailbox() :
+    m_ready(2)
+{
+}
+
+void BobFrameMailbox::resize(int size)
+{
+    for (int i = 0; i < 3; ++i) {
+        m_buffers[i].fill(0, size);
+    }
+    m_write = 0;
+    m_read = 1;
+    m_ready.storeRelease(2);
+}
+
+quint8 *BobFrameMailbox::writeBuffer()
+{
+    return reinterpret_cast<quint8 *>(m_buffers[m_write].data());
+}
+
+bool BobFrameMailbox::publish()
+{
+    int previous = m_ready.fetchAndStoreAcqRel(m_write | freshFlag);
+    m_write = previous & ~freshFlag;
+    return previous & freshFlag;
+}
+
+bool BobFrameMailbox::pending() const
+{
+    return m_ready.loadAcquire() & freshFlag;
+}
+
+bool BobFrameMailbox::take()
+{
+    if (!pending()) {
+        return false;
+    }
+    int previous = m_ready.fetchAndStoreAcqRel(m_read);
+    m_read = previous & ~freshFlag;
+    return true;
+}
+
+const quint8 *BobFrameMailbox::readBuffer() const
+{
+    return reinterpret_cast<const quint8 *>(m_buffers[m_read].constData());
+}
@@ -0,0 +1,59 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBFRAMEMAILBOX_H
+#define BOBFRAMEMAILBOX_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+// Lock-free triple buffer handing frames from one producer thread to one consumer
+// thread. The producer never waits, frames the consumer didn't pick up in time are
+// replaced by newer ones.
+class BobFrameMailbox
+{
+public:
+    BobFrameMailbox();
+
+    // Not thread safe, only call while there is no consumer
+    void resize(int size);
+
+    // Producer side: fill writeBuffer() and publish() it. Returns true if this
+    // replaced a frame the consumer never saw.
+    quint8 *writeBuffer();
+    bool publish();
+
+    // Consumer side: take() returns true if a new frame is available in readBuffer()
+    bool pending() const;
+    bool take();
+    const quint8 *readBuffer() const;
+
+private:
+    static const int freshFlag = 4;
+
+    QByteArray m_buffers[3];
+    int m_write = 0;
+    int m_read = 1;
+
+    // Index of the buffer in the middle, with freshFlag set if it holds an unread frame
+    QAtomicInt m_ready;
+};
+
+#endif // BOBFRAMEMAILBOX_H
@@ -0,0 +1,128 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobgroup.h"
+#include "bobclient.h"
+#include "bobframeclock.h"
+#include "extern-plugininfo.h"
+
+BobGroup::BobGroup(const QString &name, QObject *parent) :
+    QObject(parent),
+    m_name(name)
+{
+    m_frameClock = new BobFrameClock(this);
+}
+
+BobGroup::~BobGroup()
+{
+    foreach (BobClient *client, m_frameRates.keys()) {
+        client->setFrameClock(nullptr);
+    }
+}
+
+QString BobGroup::name() const
+{
+    return m_name;
+}
+
+BobFrameClock *BobGroup::frameClock() const
+{
+    return m_frameClock;
+}
+
+void BobGroup::addClient(BobClient *client)
+{
+    qCDebug(dcBoblight) << "Adding server to group" << m_name;
+    m_frameRates.insert(client, client->frameRate());
+    client->setFrameClock(m_frameClock);
+    // Clients may go away before the group does, e.g. when the plugin is destroyed
+    connect(client, SIGNAL(destroyed(QObject*)), this, SLOT(onClientDestroyed(QObject*)));
+    updateFrameRate();
+}
+
+void BobGroup::removeClient(BobClient *client)
+{
+    if (m_frameRates.remove(client) == 0) {
+        return;
+    }
+    disconnect(client, SIGNAL(destroyed(QObject*)), this, SLOT(onClientDestroyed(QObject*)));
+    client->setFrameClock(nullptr);
+    updateFrameRate();
+}
+
+QList<BobClient *> BobGroup::clients() const
+{
+    return m_frameRates.keys();
+}
+
+bool BobGroup::connected() const
+{
+    if (m_frameRates.isEmpty()) {
+        return false;
+    }
+    foreach (BobClient *client, m_frameRates.keys()) {
+        if (!client->connected()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BobGroup::setPower(bool power)
+{
+    foreach (BobClient *client, m_frameRates.keys()) {
+        for (int i = 0; i < client->lightsCount(); ++i) {
+            client->setPower(i, power);
+        }
+    }
+}
+
+void BobGroup::setColor(const QColor &color)
+{
+    foreach (BobClient *client, m_frameRates.keys()) {
+        client->setColor(-1, color);
+    }
+}
+
+void BobGroup::setBrightness(int brightness)
+{
+    foreach (BobClient *client, m_frameRates.keys()) {
+        for (int i = 0; i < client->lightsCount(); ++i) {
+            client->setBrightness(i, brightness);
+        }
+    }
+}
+
+void BobGroup::onClientDestroyed(QObject *object)
+{
+    // Nothing left to call on it, it released the clock in its destructor
+    m_frameRates.remove(static_cast<BobClient *>(object));
+    updateFrameRate();
+}
+
+void BobGroup::updateFrameRate()
+{
+    // The fastest member decides, slower ones would just see their transitions in more steps
+    int frameRate = 1;
+    foreach (int memberRate, m_frameRates) {
+        frameRate = qMax(frameRate, memberRate);
+    }
+    m_frameClock->setFrameRate(frameRate);
+}
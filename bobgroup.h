@@ -0,0 +1,66 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBGROUP_H
+#define BOBGROUP_H
+
+#include <QObject>
+#include <QHash>
+#include <QColor>
+
+class BobClient;
+class BobFrameClock;
+
+// Several boblight servers driven as one. All members send their frames on the ticks
+// of a shared frame clock, so changes applied to the group go out in the same frame
+// on every server. Sending itself happens in the members' backends.
+class BobGroup : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobGroup(const QString &name, QObject *parent = 0);
+    ~BobGroup();
+
+    QString name() const;
+    BobFrameClock *frameClock() const;
+
+    void addClient(BobClient *client);
+    void removeClient(BobClient *client);
+    QList<BobClient *> clients() const;
+
+    // True if all members are connected
+    bool connected() const;
+
+    void setPower(bool power);
+    void setColor(const QColor &color);
+    void setBrightness(int brightness);
+
+private slots:
+    void onClientDestroyed(QObject *object);
+
+private:
+    QString m_name;
+    BobFrameClock *m_frameClock;
+    QHash<BobClient *, int> m_frameRates;
+
+    void updateFrameRate();
+};
+
+#endif // BOBGROUP_H
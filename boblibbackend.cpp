@@ -0,0 +1,273 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "boblibbackend.h"
+#include "extern-plugininfo.h"
+
+#include "libboblight/boblight.h"
+
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+// Output threads shared by all libboblight servers. Any idle thread picks up a
+// server with a pending frame, so a server stalled in boblight_sendrgb() only
+// occupies one of them. Intentionally never deleted, a stalled send must not
+// block shutting down.
+static QThreadPool *createOutputPool()
+{
+    QThreadPool *pool = new QThreadPool();
+    pool->setMaxThreadCount(qBound(2, QThread::idealThreadCount(), 4));
+    pool->setExpiryTimeout(-1);
+    return pool;
+}
+
+static QThreadPool *outputPool()
+{
+    static QThreadPool *pool = createOutputPool();
+    return pool;
+}
+
+class BobLibSender : public QRunnable
+{
+public:
+    explicit BobLibSender(const QSharedPointer<BobLibOutput> &output) :
+        m_output(output)
+    {
+    }
+
+    void run() override
+    {
+        int priority = -1;
+        forever {
+            while (!m_output->closed.loadAcquire() && m_output->mailbox.take()) {
+                if (m_output->priority.loadAcquire() != priority) {
+                    priority = m_output->priority.loadAcquire();
+                    boblight_setpriority(m_output->boblight, priority);
+                }
+
+                const quint8 *rgb = m_output->mailbox.readBuffer();
+                for (int i = 0; i < m_output->lightsCount; ++i) {
+                    int pixel[3] = { rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2] };
+                    boblight_addpixel(m_output->boblight, i, pixel);
+                }
+
+                QElapsedTimer sendTimer;
+                sendTimer.start();
+                bool sent = boblight_sendrgb(m_output->boblight, 1, NULL);
+                {
+                    QMutexLocker locker(&m_output->latencyMutex);
+                    m_output->latencies.add(sendTimer.nsecsElapsed());
+                }
+                if (!sent) {
+                    m_output->closed.storeRelease(1);
+                    emit m_output->sendFailed(QString::fromLatin1(boblight_geterror(m_output->boblight)));
+                } else {
+                    m_output->framesSent.fetchAndAddRelaxed(1);
+                }
+            }
+
+            // Hand the server back, unless a frame came in after we checked
+            m_output->scheduled.storeRelease(0);
+            if (m_output->closed.loadAcquire() || !m_output->mailbox.pending() || !m_output->scheduled.testAndSetAcquire(0, 1)) {
+                return;
+            }
+        }
+    }
+
+private:
+    QSharedPointer<BobLibOutput> m_output;
+};
+
+BobLibOutput::BobLibOutput(void *boblight) :
+    boblight(boblight),
+    lightsCount(boblight_getnrlights(boblight)),
+    scheduled(0),
+    priority(-1),
+    closed(0),
+    framesSent(0)
+{
+    mailbox.resize(lightsCount * 3);
+}
+
+BobLibOutput::~BobLibOutput()
+{
+    boblight_destroy(boblight);
+}
+
+BobLibBackend::BobLibBackend(QObject *parent) :
+    BobBackend(parent)
+{
+}
+
+BobLibBackend::~BobLibBackend()
+{
+    // A connection attempt can't be aborted, wait for it so the handle doesn't leak
+    if (m_connectWatcher) {
+        m_connectWatcher->waitForFinished();
+        if (m_connectWatcher->result().boblight) {
+            boblight_destroy(m_connectWatcher->result().boblight);
+        }
+    }
+
+    disconnectFromServer();
+}
+
+static BobConnectResult connectWorker(const QByteArray &host, int port, int priority)
+{
+    BobConnectResult result;
+    void *boblight = boblight_init();
+
+    //try to connect, if we can't then bitch to stderr and destroy boblight
+    if (!boblight_connect(boblight, host.constData(), port, 1000000)) {
+        result.error = QString::fromLatin1(boblight_geterror(boblight));
+        boblight_destroy(boblight);
+        return result;
+    }
+
+    boblight_setpriority(boblight, priority);
+    result.boblight = boblight;
+    result.priority = priority;
+    return result;
+}
+
+void BobLibBackend::connectToServer(const QString &host, int port, int priority)
+{
+    if (m_output || m_connectWatcher) {
+        return;
+    }
+
+    // boblight_connect() blocks up to a second, run it in the global thread pool
+    m_connectWatcher = new QFutureWatcher<BobConnectResult>(this);
+    connect(m_connectWatcher, &QFutureWatcherBase::finished, this, &BobLibBackend::onConnectFinished);
+    m_connectWatcher->setFuture(QtConcurrent::run(connectWorker, host.toLatin1(), port, priority));
+}
+
+void BobLibBackend::disconnectFromServer()
+{
+    if (m_output) {
+        // A sender still working on it keeps the output alive until it's done
+        m_output->closed.storeRelease(1);
+        m_output->disconnect(this);
+        m_framesWritten += static_cast<uint>(m_output->framesSent.fetchAndStoreRelaxed(0));
+        {
+            // Keep the numbers of the last connection around
+            QMutexLocker locker(&m_output->latencyMutex);
+            m_sendLatencies = m_output->latencies;
+        }
+        m_output.clear();
+    }
+}
+
+bool BobLibBackend::connected() const
+{
+    return !m_output.isNull();
+}
+
+bool BobLibBackend::connecting() const
+{
+    return m_connectWatcher != nullptr;
+}
+
+int BobLibBackend::lightsCount() const
+{
+    if (!m_output) {
+        return 0;
+    }
+    return m_output->lightsCount;
+}
+
+void BobLibBackend::setPriority(int priority)
+{
+    if (m_output) {
+        qCDebug(dcBoblight) << "setting priority to" << priority;
+        m_output->priority.storeRelease(priority);
+    }
+}
+
+bool BobLibBackend::sendFrame(const quint8 *rgb)
+{
+    if (!m_output) {
+        m_error = QStringLiteral("Not connected");
+        return false;
+    }
+
+    // Errors of the actual send are reported asynchronously through disconnected().
+    // libboblight doesn't tell how much it writes, bytesWritten() isn't counted.
+    memcpy(m_output->mailbox.writeBuffer(), rgb, m_output->lightsCount * 3);
+    m_framesWritten += static_cast<uint>(m_output->framesSent.fetchAndStoreRelaxed(0));
+    if (m_output->mailbox.publish()) {
+        m_framesSkipped++;
+    }
+    if (m_output->scheduled.testAndSetAcquire(0, 1)) {
+        outputPool()->start(new BobLibSender(m_output));
+    }
+    return true;
+}
+
+QString BobLibBackend::errorString() const
+{
+    return m_error;
+}
+
+double BobLibBackend::sendLatency(int percentile) const
+{
+    if (!m_output) {
+        return m_sendLatencies.percentile(percentile);
+    }
+    QMutexLocker locker(&m_output->latencyMutex);
+    return m_output->latencies.percentile(percentile);
+}
+
+quint64 BobLibBackend::framesWritten() const
+{
+    // Whatever the output thread sent since the last frame was handed over
+    return m_framesWritten + (m_output ? static_cast<uint>(m_output->framesSent.loadAcquire()) : 0);
+}
+
+void BobLibBackend::onConnectFinished()
+{
+    BobConnectResult result = m_connectWatcher->result();
+    m_connectWatcher->deleteLater();
+    m_connectWatcher = nullptr;
+
+    m_error = result.error;
+    if (!result.boblight) {
+        emit connectFinished(false);
+        return;
+    }
+
+    // Deleted with deleteLater() as the last reference might be dropped in an output thread
+    m_output = QSharedPointer<BobLibOutput>(new BobLibOutput(result.boblight), &QObject::deleteLater);
+    m_output->priority.storeRelease(result.priority);
+    connect(m_output.data(), &BobLibOutput::sendFailed, this, &BobLibBackend::onSendFailed);
+    emit connectFinished(true);
+}
+
+void BobLibBackend::onSendFailed(const QString &error)
+{
+    m_error = error;
+    disconnectFromServer();
+    emit disconnected();
+}
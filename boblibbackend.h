@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBLIBBACKEND_H
+#define BOBLIBBACKEND_H
+
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QMutex>
+
+#include "bobbackend.h"
+#include "bobframemailbox.h"
+
+struct BobConnectResult
+{
+    void *boblight = nullptr;
+    int priority = 128;
+    QString error;
+};
+
+// State shared between a BobLibBackend and the output thread sending its frames.
+// The libboblight handle is destroyed with it, once neither side uses it anymore.
+class BobLibOutput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobLibOutput(void *boblight);
+    ~BobLibOutput();
+
+    void *boblight;
+    int lightsCount;
+    BobFrameMailbox mailbox;
+    QAtomicInt scheduled;
+    QAtomicInt priority;
+    QAtomicInt closed;
+    // Frames sent by the output thread, collected by the backend now and then
+    QAtomicInt framesSent;
+    // Duration of boblight_sendrgb(), written by the output thread
+    mutable QMutex latencyMutex;
+    BobSendLatencies latencies;
+
+signals:
+    void sendFailed(const QString &error);
+};
+
+// Talks to boblightd through libboblight. The blocking libboblight calls for sending
+// frames are done in a small pool of output threads.
+class BobLibBackend : public BobBackend
+{
+    Q_OBJECT
+public:
+    explicit BobLibBackend(QObject *parent = 0);
+    ~BobLibBackend();
+
+    void connectToServer(const QString &host, int port, int priority) override;
+    void disconnectFromServer() override;
+    bool connected() const override;
+    bool connecting() const override;
+
+    int lightsCount() const override;
+    void setPriority(int priority) override;
+
+    bool sendFrame(const quint8 *rgb) override;
+
+    QString errorString() const override;
+
+    quint64 framesWritten() const override;
+    // libboblight doesn't tell how much it writes
+    bool countsBytesWritten() const override { return false; }
+    double sendLatency(int percentile) const override;
+
+private:
+    QSharedPointer<BobLibOutput> m_output;
+    QFutureWatcher<BobConnectResult> *m_connectWatcher = nullptr;
+    QString m_error;
+
+private slots:
+    void onConnectFinished();
+    void onSendFailed(const QString &error);
+};
+
+#endif // BOBLIBBACKEND_H
@@ -1,20 +1,53 @@
 include(/usr/include/nymea/plugin.pri)
 
-QT += dbus bluetooth concurrent
+QT += dbus bluetooth concurrent network
 
 CONFIG += c++11
 
 TARGET = $$qtLibraryTarget(nymea_devicepluginboblight)
-LIBS += -lboblight
 
 SOURCES += \
     devicepluginboblight.cpp \
     bobclient.cpp \
-    bobchannel.cpp
+    bobchannel.cpp \
+    bobanimator.cpp \
+    boboutputstage.cpp \
+    bobframemailbox.cpp \
+    bobframeclock.cpp \
+    bobnativebackend.cpp \
+    bobstatereporter.cpp \
+    bobcolortemperature.cpp \
+    bobeffectengine.cpp \
+    bobstreaminput.cpp \
+    bobgroup.cpp \
+    bobrecording.cpp \
+    bobcompositor.cpp
 
 HEADERS += \
     devicepluginboblight.h \
     bobclient.h \
-    bobchannel.h
-
+    bobchannel.h \
+    bobanimator.h \
+    boboutputstage.h \
+    bobframemailbox.h \
+    bobframeclock.h \
+    bobbackend.h \
+    bobnativebackend.h \
+    bobstatereporter.h \
+    bobcolortemperature.h \
+    bobeffectengine.h \
+    bobstreaminput.h \
+    bobgroup.h \
+    bobrecording.h \
+    bobcompositor.h
 
+# libboblight is optional, the native protocol implementation is always built.
+# Pass CONFIG+=nolibboblight to qmake to build without it.
+!nolibboblight:exists(/usr/include/libboblight/boblight.h) {
+    DEFINES += WITH_LIBBOBLIGHT
+    LIBS += -lboblight
+    SOURCES += boblibbackend.cpp
+    HEADERS += boblibbackend.h
+} else {
+    message("Building without libboblight. Only the native boblight protocol will be available.")
+}
@@ -0,0 +1,348 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobnativebackend.h"
+#include "extern-plugininfo.h"
+
+#include <QVector>
+
+#include <string.h>
+
+// Protocol version spoken by boblightd 2.x
+static const int boblightProtocolVersion = 5;
+
+// Frames only carry the lights which changed. Every this many ms all lights are sent
+// anyway, in case boblightd and we disagree about a light.
+static const int fullRefreshInterval = 2000;
+
+// boblightd expects color values as floats in the range 0..1. There are only 256
+// possible values, so format them once instead of for every light of every frame.
+static QVector<QByteArray> buildLevelStrings()
+{
+    QVector<QByteArray> levels(256);
+    for (int i = 0; i < 256; ++i) {
+        levels[i] = QByteArray::number(i / 255.0, 'f', 6);
+    }
+    return levels;
+}
+
+static const QByteArray &levelString(quint8 level)
+{
+    static const QVector<QByteArray> levels = buildLevelStrings();
+    return levels.at(level);
+}
+
+BobNativeBackend::BobNativeBackend(QObject *parent) :
+    BobBackend(parent)
+{
+    m_socket = new QTcpSocket(this);
+    connect(m_socket, &QTcpSocket::connected, this, &BobNativeBackend::onConnected);
+    connect(m_socket, &QTcpSocket::readyRead, this, &BobNativeBackend::onReadyRead);
+    connect(m_socket, &QTcpSocket::bytesWritten, this, &BobNativeBackend::onBytesWritten);
+    connect(m_socket, &QTcpSocket::disconnected, this, &BobNativeBackend::onDisconnected);
+    connect(m_socket, static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error), this, &BobNativeBackend::onError);
+
+    // Same timeout as we used to pass to boblight_connect()
+    m_handshakeTimer = new QTimer(this);
+    m_handshakeTimer->setSingleShot(true);
+    m_handshakeTimer->setInterval(1000);
+    connect(m_handshakeTimer, &QTimer::timeout, this, &BobNativeBackend::onHandshakeTimeout);
+}
+
+void BobNativeBackend::connectToServer(const QString &host, int port, int priority)
+{
+    if (m_state != StateDisconnected) {
+        return;
+    }
+
+    m_priority = priority;
+    m_error.clear();
+    m_lightNames.clear();
+    m_expectedLights = 0;
+    m_pingsPending = 0;
+    m_transmitted.clear();
+    m_state = StateConnecting;
+    m_handshakeTimer->start();
+    m_socket->connectToHost(host, port);
+}
+
+void BobNativeBackend::disconnectFromServer()
+{
+    m_handshakeTimer->stop();
+    m_framePending = false;
+    m_transmitted.clear();
+    m_sendTimer.invalidate();
+    m_state = StateDisconnected;
+    m_socket->abort();
+}
+
+bool BobNativeBackend::connected() const
+{
+    return m_state == StateConnected;
+}
+
+bool BobNativeBackend::connecting() const
+{
+    return m_state != StateDisconnected && m_state != StateConnected;
+}
+
+int BobNativeBackend::lightsCount() const
+{
+    return m_lightNames.count();
+}
+
+void BobNativeBackend::setPriority(int priority)
+{
+    m_priority = priority;
+    if (m_state == StateConnected) {
+        qCDebug(dcBoblight) << "setting priority to" << priority;
+        m_socket->write("set priority " + QByteArray::number(priority) + "\n");
+    }
+}
+
+bool BobNativeBackend::sendFrame(const quint8 *rgb)
+{
+    if (m_state != StateConnected) {
+        m_error = QStringLiteral("Not connected");
+        return false;
+    }
+
+    // Build the whole frame and hand it to the socket in one write. Lights are compared
+    // against what has actually been written, a frame still waiting to be written is
+    // replaced as a whole.
+    int bytes = m_lightNames.count() * 3;
+    bool fullRefresh = m_transmitted.size() != bytes || !m_lastFullRefresh.isValid() || m_lastFullRefresh.elapsed() >= fullRefreshInterval;
+    const quint8 *transmitted = reinterpret_cast<const quint8 *>(m_transmitted.constData());
+    m_frameBuffer.resize(0);
+    for (int i = 0; i < m_lightNames.count(); ++i) {
+        if (!fullRefresh && memcmp(rgb + i * 3, transmitted + i * 3, 3) == 0) {
+            continue;
+        }
+        m_frameBuffer.append("set light ").append(m_lightNames.at(i)).append(" rgb ");
+        m_frameBuffer.append(levelString(rgb[i * 3])).append(' ');
+        m_frameBuffer.append(levelString(rgb[i * 3 + 1])).append(' ');
+        m_frameBuffer.append(levelString(rgb[i * 3 + 2])).append('\n');
+    }
+    m_frameBuffer.append("sync\n");
+    m_frameRgb.resize(bytes);
+    memcpy(m_frameRgb.data(), rgb, bytes);
+    m_frameIsFullRefresh = fullRefresh;
+
+    // Don't queue up frames if boblightd doesn't keep up, send the latest one once
+    // the previous has been written
+    if (m_socket->bytesToWrite() > 0) {
+        if (m_framePending) {
+            m_framesSkipped++;
+        }
+        m_framePending = true;
+        return true;
+    }
+
+    return writeFrame();
+}
+
+void BobNativeBackend::reserveFrameBuffer()
+{
+    // A full frame is "set light NAME rgb R G B" per light with 8 characters per level.
+    // Reserving it up front keeps resize(0) from dropping the buffer on every frame.
+    int size = 5;
+    foreach (const QByteArray &name, m_lightNames) {
+        size += name.size() + 42;
+    }
+    m_frameBuffer.reserve(size);
+    m_frameRgb.reserve(m_lightNames.count() * 3);
+    m_transmitted.reserve(m_lightNames.count() * 3);
+}
+
+bool BobNativeBackend::writeFrame()
+{
+    m_framePending = false;
+    if (m_socket->write(m_frameBuffer) != m_frameBuffer.size()) {
+        m_error = m_socket->errorString();
+        return false;
+    }
+    m_bytesWritten += m_frameBuffer.size();
+    m_framesWritten++;
+    m_sendTimer.start();
+
+    m_transmitted.swap(m_frameRgb);
+    if (m_frameIsFullRefresh) {
+        m_lastFullRefresh.start();
+    }
+    return true;
+}
+
+bool BobNativeBackend::ping()
+{
+    if (m_state != StateConnected) {
+        return false;
+    }
+
+    // The previous one had a whole keepalive interval to come back
+    if (m_pingsPending > 0) {
+        m_error = QStringLiteral("boblightd stopped answering pings");
+        m_state = StateDisconnected;
+        m_socket->abort();
+        emit disconnected();
+        return true;
+    }
+    m_pingsPending++;
+    m_socket->write("ping\n");
+    return true;
+}
+
+QString BobNativeBackend::errorString() const
+{
+    return m_error;
+}
+
+void BobNativeBackend::processLine(const QByteArray &line)
+{
+    QList<QByteArray> words = line.split(' ');
+
+    switch (m_state) {
+    case StateHello:
+        if (words.first() != "hello") {
+            abortHandshake(QString("Unexpected greeting: %1").arg(QString(line)));
+            return;
+        }
+        m_state = StateVersion;
+        m_socket->write("get version\n");
+        return;
+    case StateVersion:
+        if (words.count() != 2 || words.first() != "version" || words.at(1).toInt() != boblightProtocolVersion) {
+            abortHandshake(QString("Unsupported protocol version: %1").arg(QString(line)));
+            return;
+        }
+        m_state = StateLights;
+        m_socket->write("get lights\n");
+        return;
+    case StateLights:
+        if (words.first() == "lights" && words.count() == 2) {
+            m_expectedLights = words.at(1).toInt();
+        } else if (words.first() == "light" && words.count() >= 2) {
+            m_lightNames.append(words.at(1));
+        } else {
+            abortHandshake(QString("Unexpected reply to get lights: %1").arg(QString(line)));
+            return;
+        }
+        if (m_lightNames.count() < m_expectedLights) {
+            return;
+        }
+        m_handshakeTimer->stop();
+        m_state = StateConnected;
+        reserveFrameBuffer();
+        m_socket->write("set priority " + QByteArray::number(m_priority) + "\n");
+        emit connectFinished(true);
+        return;
+    case StateConnected:
+        // Replies to ping, nothing else is sent by boblightd on its own
+        if (words.first() == "ping") {
+            m_pingsPending = qMax(0, m_pingsPending - 1);
+        } else {
+            qCDebug(dcBoblight) << "Unhandled message from boblightd:" << line;
+        }
+        return;
+    case StateDisconnected:
+    case StateConnecting:
+        return;
+    }
+}
+
+void BobNativeBackend::abortHandshake(const QString &error)
+{
+    m_handshakeTimer->stop();
+    m_error = error;
+    m_state = StateDisconnected;
+    m_socket->abort();
+    emit connectFinished(false);
+}
+
+void BobNativeBackend::onConnected()
+{
+    // Only takes effect once there is a socket, frames shouldn't wait for Nagle
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    m_state = StateHello;
+    m_socket->write("hello\n");
+}
+
+void BobNativeBackend::onReadyRead()
+{
+    while (m_socket->canReadLine()) {
+        QByteArray line = m_socket->readLine().trimmed();
+        if (!line.isEmpty()) {
+            processLine(line);
+        }
+        if (m_state == StateDisconnected) {
+            return;
+        }
+    }
+}
+
+void BobNativeBackend::onBytesWritten()
+{
+    if (m_sendTimer.isValid() && m_socket->bytesToWrite() == 0) {
+        m_sendLatencies.add(m_sendTimer.nsecsElapsed());
+        m_sendTimer.invalidate();
+    }
+    if (m_framePending && m_state == StateConnected && m_socket->bytesToWrite() == 0) {
+        if (!writeFrame()) {
+            onError();
+        }
+    }
+}
+
+void BobNativeBackend::onDisconnected()
+{
+    if (m_state == StateDisconnected) {
+        return;
+    }
+
+    if (m_state != StateConnected) {
+        abortHandshake(QStringLiteral("Connection closed by boblightd"));
+        return;
+    }
+
+    m_error = QStringLiteral("Connection closed by boblightd");
+    m_state = StateDisconnected;
+    emit disconnected();
+}
+
+void BobNativeBackend::onError()
+{
+    if (m_state == StateDisconnected) {
+        return;
+    }
+
+    if (m_state != StateConnected) {
+        abortHandshake(m_socket->errorString());
+        return;
+    }
+
+    m_error = m_socket->errorString();
+    m_state = StateDisconnected;
+    m_socket->abort();
+    emit disconnected();
+}
+
+void BobNativeBackend::onHandshakeTimeout()
+{
+    abortHandshake(QStringLiteral("Timeout connecting to boblightd"));
+}
@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBNATIVEBACKEND_H
+#define BOBNATIVEBACKEND_H
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QByteArray>
+#include <QList>
+#include <QElapsedTimer>
+
+#include "bobbackend.h"
+
+// Event driven implementation of the boblightd text protocol. Only lights which changed
+// since the last frame are sent, with a full frame every now and then.
+class BobNativeBackend : public BobBackend
+{
+    Q_OBJECT
+public:
+    explicit BobNativeBackend(QObject *parent = 0);
+
+    void connectToServer(const QString &host, int port, int priority) override;
+    void disconnectFromServer() override;
+    bool connected() const override;
+    bool connecting() const override;
+
+    int lightsCount() const override;
+    void setPriority(int priority) override;
+
+    bool sendFrame(const quint8 *rgb) override;
+    bool ping() override;
+
+    QString errorString() const override;
+
+private:
+    enum State {
+        StateDisconnected,
+        StateConnecting,
+        StateHello,
+        StateVersion,
+        StateLights,
+        StateConnected
+    };
+
+    QTcpSocket *m_socket;
+    QTimer *m_handshakeTimer;
+    State m_state = StateDisconnected;
+    QString m_error;
+    int m_priority = 128;
+
+    int m_expectedLights = 0;
+    int m_pingsPending = 0;
+    QList<QByteArray> m_lightNames;
+    QByteArray m_frameBuffer;
+    bool m_framePending = false;
+
+    // Colors in m_frameBuffer and the ones last written to the socket, 3 bytes per light
+    QByteArray m_frameRgb;
+    QByteArray m_transmitted;
+    bool m_frameIsFullRefresh = false;
+    QElapsedTimer m_lastFullRefresh;
+    // Runs from writing a frame until the socket handed all of it to the system
+    QElapsedTimer m_sendTimer;
+
+    void reserveFrameBuffer();
+    bool writeFrame();
+    void processLine(const QByteArray &line);
+    void abortHandshake(const QString &error);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+    void onError();
+    void onHandshakeTimeout();
+};
+
+#endif // BOBNATIVEBACKEND_H
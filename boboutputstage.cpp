@@ -0,0 +1,215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "boboutputstage.h"
+
+#include <qmath.h>
+#include <string.h>
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN && defined(__SSE2__)
+#include <emmintrin.h>
+#define BOB_OUTPUT_SSE2
+#elif Q_BYTE_ORDER == Q_LITTLE_ENDIAN && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+#define BOB_OUTPUT_NEON
+#endif
+
+// Exact floor(value * alpha / 255) for value, alpha in 0..255 without a division
+static inline quint8 premultiply(uint value, uint alpha)
+{
+    uint t = value * alpha;
+    return (t + 1 + (t >> 8)) >> 8;
+}
+
+static const int lutSize = (255 * 255 >> 4) + 1;
+
+// Frames dithering continues after the last change of the input. Without a limit a
+// static level between two output levels would keep the frame clock running forever.
+static const int ditherSettleFrames = 32;
+
+BobOutputStage::BobOutputStage()
+{
+    setCurve(CurveLinear);
+}
+
+BobOutputStage::Curve BobOutputStage::curve() const
+{
+    return m_curve;
+}
+
+double BobOutputStage::gamma() const
+{
+    return m_gamma;
+}
+
+void BobOutputStage::setCurve(Curve curve, double gamma)
+{
+    m_curve = curve;
+    m_gamma = qBound(0.1, gamma, 10.0);
+
+    m_lut.resize(lutSize);
+    for (int i = 0; i < lutSize; ++i) {
+        double x = qMin(i * 16 + 8, 255 * 255) / double(255 * 255);
+        if (i == 0) {
+            x = 0;
+        }
+        double y = x;
+        switch (m_curve) {
+        case CurveLinear:
+            break;
+        case CurveGamma:
+            y = qPow(x, m_gamma);
+            break;
+        case CurvePerceptual:
+            // Inverse of CIE L*, x being the lightness
+            y = x > 0.08 ? qPow((x + 0.16) / 1.16, 3) : x / 9.033;
+            break;
+        }
+        m_lut[i] = qBound(0, qRound(y * 255 * 256), 255 * 256);
+    }
+}
+
+bool BobOutputStage::dithering() const
+{
+    return m_dithering;
+}
+
+void BobOutputStage::setDithering(bool dithering)
+{
+    m_dithering = dithering;
+    m_residue.fill(0);
+    m_ditherInput.clear();
+    m_ditherFrames = 0;
+}
+
+bool BobOutputStage::process(const QRgb *argb, quint8 *rgb, int count)
+{
+    if (m_curve != CurveLinear || m_dithering) {
+        return processLut(argb, rgb, count);
+    }
+
+    int i = 0;
+
+#if defined(BOB_OUTPUT_SSE2)
+    // 4 lights per iteration, in memory a QRgb is B, G, R, A
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(argb + i));
+
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+        __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        // value * alpha fits into 16 bits, so does t + 1 + (t >> 8)
+        lo = _mm_mullo_epi16(lo, alphaLo);
+        hi = _mm_mullo_epi16(hi, alphaHi);
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+
+        quint8 packed[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(packed), _mm_packus_epi16(lo, hi));
+        for (int j = 0; j < 4; ++j) {
+            rgb[(i + j) * 3] = packed[j * 4 + 2];
+            rgb[(i + j) * 3 + 1] = packed[j * 4 + 1];
+            rgb[(i + j) * 3 + 2] = packed[j * 4];
+        }
+    }
+#elif defined(BOB_OUTPUT_NEON)
+    // 8 lights per iteration, vld4 splits the B, G, R, A bytes into separate lanes
+    const uint16x8_t one = vdupq_n_u16(1);
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t pixels = vld4_u8(reinterpret_cast<const uint8_t *>(argb + i));
+        uint8x8x3_t out;
+        for (int c = 0; c < 3; ++c) {
+            uint16x8_t t = vmull_u8(pixels.val[2 - c], pixels.val[3]);
+            out.val[c] = vmovn_u16(vshrq_n_u16(vaddq_u16(vaddq_u16(t, one), vshrq_n_u16(t, 8)), 8));
+        }
+        vst3_u8(rgb + i * 3, out);
+    }
+#endif
+
+    processScalar(argb + i, rgb + i * 3, count - i);
+    return false;
+}
+
+void BobOutputStage::processScalar(const QRgb *argb, quint8 *rgb, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        uint alpha = qAlpha(argb[i]);
+        rgb[i * 3] = premultiply(qRed(argb[i]), alpha);
+        rgb[i * 3 + 1] = premultiply(qGreen(argb[i]), alpha);
+        rgb[i * 3 + 2] = premultiply(qBlue(argb[i]), alpha);
+    }
+}
+
+void BobOutputStage::processRounded(const QRgb *argb, quint8 *rgb, int count)
+{
+    const quint16 *lut = m_lut.constData();
+    for (int i = 0; i < count; ++i) {
+        uint alpha = qAlpha(argb[i]);
+        rgb[i * 3] = (lut[(qRed(argb[i]) * alpha) >> 4] + 128) >> 8;
+        rgb[i * 3 + 1] = (lut[(qGreen(argb[i]) * alpha) >> 4] + 128) >> 8;
+        rgb[i * 3 + 2] = (lut[(qBlue(argb[i]) * alpha) >> 4] + 128) >> 8;
+    }
+}
+
+bool BobOutputStage::processLut(const QRgb *argb, quint8 *rgb, int count)
+{
+    if (!m_dithering) {
+        processRounded(argb, rgb, count);
+        return false;
+    }
+
+    if (m_ditherInput.count() != count || memcmp(m_ditherInput.constData(), argb, count * sizeof(QRgb)) != 0) {
+        m_ditherInput.resize(count);
+        memcpy(m_ditherInput.data(), argb, count * sizeof(QRgb));
+        m_ditherFrames = ditherSettleFrames;
+    }
+    if (m_ditherFrames == 0) {
+        // Settled, rest on the nearest levels until something changes
+        processRounded(argb, rgb, count);
+        m_residue.fill(0);
+        return false;
+    }
+    m_ditherFrames--;
+
+    const quint16 *lut = m_lut.constData();
+
+    // First order error feedback over time: whatever got truncated in this frame
+    // is carried into the next one, so the average over frames hits the exact level
+    if (m_residue.count() != count * 3) {
+        m_residue.fill(0, count * 3);
+    }
+    quint8 *residue = m_residue.data();
+    uint fractional = 0;
+    for (int i = 0; i < count; ++i) {
+        uint alpha = qAlpha(argb[i]);
+        uint levels[3] = { lut[(qRed(argb[i]) * alpha) >> 4], lut[(qGreen(argb[i]) * alpha) >> 4], lut[(qBlue(argb[i]) * alpha) >> 4] };
+        for (int c = 0; c < 3; ++c) {
+            uint level = levels[c] + residue[i * 3 + c];
+            rgb[i * 3 + c] = level >> 8;
+            residue[i * 3 + c] = level & 0xff;
+            fractional |= levels[c] & 0xff;
+        }
+    }
+    return fractional != 0;
+}
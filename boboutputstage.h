@@ -0,0 +1,72 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBOUTPUTSTAGE_H
+#define BOBOUTPUTSTAGE_H
+
+#include <QRgb>
+#include <QVector>
+
+// Turns the animated channel colors of a BobClient into the RGB bytes sent to boblightd
+class BobOutputStage
+{
+public:
+    enum Curve {
+        CurveLinear,
+        CurveGamma,
+        CurvePerceptual // CIE 1976 lightness (L*)
+    };
+
+    BobOutputStage();
+
+    Curve curve() const;
+    double gamma() const;
+    // Bakes the curve into a lookup table, nothing is computed per pixel
+    void setCurve(Curve curve, double gamma = 2.2);
+
+    // Temporal dithering spreads the fractional part of each output level across
+    // consecutive frames, so dim levels and slow fades don't step visibly. It stops a
+    // few frames after the values last changed and settles on the nearest level.
+    bool dithering() const;
+    void setDithering(bool dithering);
+
+    // Premultiplies count ARGB values with their alpha (which carries the brightness)
+    // and packs them into 3 bytes per light. With a linear curve and without dithering
+    // this is vectorized where available, the scalar fallback produces the exact same
+    // output. Returns true if dithering needs further frames to represent the values.
+    bool process(const QRgb *argb, quint8 *rgb, int count);
+
+private:
+    Curve m_curve = CurveLinear;
+    double m_gamma = 2.2;
+    bool m_dithering = false;
+
+    // Output level in 8.8 fixed point, indexed by (value * alpha) >> 4
+    QVector<quint16> m_lut;
+    QVector<quint8> m_residue;
+    QVector<QRgb> m_ditherInput;
+    int m_ditherFrames = 0;
+
+    static void processScalar(const QRgb *argb, quint8 *rgb, int count);
+    void processRounded(const QRgb *argb, quint8 *rgb, int count);
+    bool processLut(const QRgb *argb, quint8 *rgb, int count);
+};
+
+#endif // BOBOUTPUTSTAGE_H
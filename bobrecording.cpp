@@ -0,0 +1,329 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobrecording.h"
+#include "extern-plugininfo.h"
+
+#include <QtEndian>
+
+#include <string.h>
+
+static const char recordingMagic[6] = { 'B', 'O', 'B', 'R', 'E', 'C' };
+static const int recordingVersion = 1;
+static const int headerSize = 12;
+// Far more than a boblightd drives, but keeps a broken header from allocating gigabytes
+static const quint32 maximumLightsCount = 65536;
+
+static void appendVarint(QByteArray &buffer, quint32 value)
+{
+    while (value >= 0x80) {
+        buffer.append(char(value | 0x80));
+        value >>= 7;
+    }
+    buffer.append(char(value));
+}
+
+BobRecorder::BobRecorder()
+{
+}
+
+BobRecorder::~BobRecorder()
+{
+    stop();
+}
+
+bool BobRecorder::start(const QString &fileName, int lightsCount)
+{
+    stop();
+
+    if (lightsCount <= 0 || quint32(lightsCount) > maximumLightsCount) {
+        m_errorString = QString("Unsupported number of lights: %1").arg(lightsCount);
+        return false;
+    }
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_lightsCount = lightsCount;
+    m_lastTimestamp = -1;
+    m_previous.fill(0, lightsCount * 3);
+    m_buffer.reserve(64 * 1024);
+    m_buffer.resize(0);
+
+    char header[headerSize];
+    memcpy(header, recordingMagic, sizeof(recordingMagic));
+    header[6] = recordingVersion;
+    header[7] = 0;
+    qToLittleEndian<quint32>(lightsCount, reinterpret_cast<uchar *>(header + 8));
+    m_buffer.append(header, headerSize);
+    return true;
+}
+
+void BobRecorder::stop()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    flush();
+    m_file.close();
+}
+
+bool BobRecorder::recording() const
+{
+    return m_file.isOpen();
+}
+
+int BobRecorder::lightsCount() const
+{
+    return m_lightsCount;
+}
+
+QString BobRecorder::errorString() const
+{
+    return m_errorString;
+}
+
+void BobRecorder::record(qint64 timestamp, const quint8 *rgb)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    appendVarint(m_buffer, m_lastTimestamp < 0 ? 0 : quint32(timestamp - m_lastTimestamp));
+    m_lastTimestamp = timestamp;
+
+    quint8 *previous = reinterpret_cast<quint8 *>(m_previous.data());
+    int light = 0;
+    int runEnd = 0;
+    while (light < m_lightsCount) {
+        if (memcmp(rgb + light * 3, previous + light * 3, 3) == 0) {
+            light++;
+            continue;
+        }
+        int runStart = light;
+        while (light < m_lightsCount && memcmp(rgb + light * 3, previous + light * 3, 3) != 0) {
+            light++;
+        }
+        appendVarint(m_buffer, runStart - runEnd);
+        appendVarint(m_buffer, light - runStart);
+        m_buffer.append(reinterpret_cast<const char *>(rgb + runStart * 3), (light - runStart) * 3);
+        runEnd = light;
+    }
+    appendVarint(m_buffer, 0);
+    appendVarint(m_buffer, 0);
+    memcpy(previous, rgb, m_lightsCount * 3);
+
+    if (m_buffer.size() > 32 * 1024) {
+        flush();
+    }
+}
+
+void BobRecorder::flush()
+{
+    if (m_file.write(m_buffer) != m_buffer.size()) {
+        qCWarning(dcBoblight) << "Writing recording" << m_file.fileName() << "failed:" << m_file.errorString();
+        m_errorString = m_file.errorString();
+        m_file.close();
+    }
+    m_buffer.resize(0);
+}
+
+
+BobPlayer::BobPlayer(QObject *parent) :
+    QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &BobPlayer::onTimeout);
+}
+
+BobPlayer::~BobPlayer()
+{
+    close();
+}
+
+bool BobPlayer::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+    m_size = m_file.size();
+    m_data = m_size >= headerSize ? m_file.map(0, m_size) : nullptr;
+    if (!m_data || memcmp(m_data, recordingMagic, sizeof(recordingMagic)) != 0 || m_data[6] != recordingVersion) {
+        m_errorString = QStringLiteral("Not a boblight recording");
+        close();
+        return false;
+    }
+
+    quint32 lightsCount = qFromLittleEndian<quint32>(m_data + 8);
+    if (lightsCount == 0 || lightsCount > maximumLightsCount) {
+        m_errorString = QString("Unsupported number of lights: %1").arg(lightsCount);
+        close();
+        return false;
+    }
+    m_lightsCount = lightsCount;
+    m_frame.fill(0, m_lightsCount * 3);
+    m_position = headerSize;
+    return true;
+}
+
+void BobPlayer::close()
+{
+    stop();
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_lightsCount = 0;
+}
+
+QString BobPlayer::errorString() const
+{
+    return m_errorString;
+}
+
+int BobPlayer::lightsCount() const
+{
+    return m_lightsCount;
+}
+
+void BobPlayer::play(bool loop)
+{
+    if (!m_data) {
+        return;
+    }
+    m_loop = loop;
+    m_position = headerSize;
+    m_frame.fill(0);
+    m_due = 0;
+    m_loopStart = 0;
+    m_clock.start();
+    scheduleNext();
+}
+
+void BobPlayer::stop()
+{
+    m_timer->stop();
+    m_fresh = false;
+}
+
+bool BobPlayer::playing() const
+{
+    return m_timer->isActive() || m_fresh;
+}
+
+bool BobPlayer::takeFrame(quint8 *rgb, int bytes)
+{
+    if (!m_fresh) {
+        return false;
+    }
+    int recorded = qMin(bytes, m_frame.size());
+    memcpy(rgb, m_frame.constData(), recorded);
+    memset(rgb + recorded, 0, bytes - recorded);
+    m_fresh = false;
+    return true;
+}
+
+void BobPlayer::onTimeout()
+{
+    if (!decodeFrame()) {
+        qCWarning(dcBoblight) << "Recording" << m_file.fileName() << "is corrupt at offset" << m_position;
+        stop();
+        emit finished();
+        return;
+    }
+    m_fresh = true;
+    emit frameAvailable();
+    scheduleNext();
+}
+
+bool BobPlayer::readVarint(quint32 *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 32 && m_position < m_size; shift += 7) {
+        uchar byte = m_data[m_position++];
+        *value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BobPlayer::decodeFrame()
+{
+    quint8 *frame = reinterpret_cast<quint8 *>(m_frame.data());
+    int light = 0;
+    forever {
+        quint32 skip;
+        quint32 count;
+        if (!readVarint(&skip) || !readVarint(&count)) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        if (qint64(light) + skip + count > m_lightsCount || m_position + qint64(count) * 3 > m_size) {
+            return false;
+        }
+        light += skip;
+        memcpy(frame + light * 3, m_data + m_position, count * 3);
+        m_position += count * 3;
+        light += count;
+    }
+}
+
+void BobPlayer::scheduleNext()
+{
+    if (m_position >= m_size) {
+        if (!m_loop) {
+            emit finished();
+            return;
+        }
+        if (m_due == m_loopStart) {
+            // Nothing to wait for in between, looping would just spin
+            emit finished();
+            return;
+        }
+        m_position = headerSize;
+        m_frame.fill(0);
+        m_loopStart = m_due;
+    }
+
+    quint32 delay;
+    if (!readVarint(&delay)) {
+        qCWarning(dcBoblight) << "Recording" << m_file.fileName() << "is truncated";
+        emit finished();
+        return;
+    }
+
+    // Due times add up from the start of the playback, so timer inaccuracies don't accumulate
+    m_due += delay;
+    m_timer->start(qMax<qint64>(0, m_due - m_clock.elapsed()));
+}
@@ -0,0 +1,114 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBRECORDING_H
+#define BOBRECORDING_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+
+// Recordings are a 12 byte header ("BOBREC", version, 0, lights count as 32 bit little
+// endian) followed by one record per frame:
+//   varint  milliseconds since the previous frame
+//   runs of changed lights: varint unchanged lights to skip, varint changed lights,
+//           3 bytes R, G, B per changed light
+//   varint 0, varint 0 terminating the frame
+// The first frame is encoded against an all black frame.
+
+// Appends the frames sent by a BobClient to a recording
+class BobRecorder
+{
+public:
+    BobRecorder();
+    ~BobRecorder();
+
+    bool start(const QString &fileName, int lightsCount);
+    void stop();
+    bool recording() const;
+    int lightsCount() const;
+    QString errorString() const;
+
+    void record(qint64 timestamp, const quint8 *rgb);
+
+private:
+    QFile m_file;
+    QString m_errorString;
+    int m_lightsCount = 0;
+    qint64 m_lastTimestamp = -1;
+    QByteArray m_previous;
+    QByteArray m_buffer;
+
+    void flush();
+};
+
+// Plays back a recording with the original timing. The file is memory mapped and
+// decoded one frame at a time.
+class BobPlayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobPlayer(QObject *parent = 0);
+    ~BobPlayer();
+
+    bool open(const QString &fileName);
+    void close();
+    QString errorString() const;
+    int lightsCount() const;
+
+    void play(bool loop = false);
+    void stop();
+    bool playing() const;
+
+    // Copies the current frame to rgb if it hasn't been taken yet. Lights beyond the
+    // recorded ones are set to black.
+    bool takeFrame(quint8 *rgb, int bytes);
+
+signals:
+    void frameAvailable();
+    void finished();
+
+private slots:
+    void onTimeout();
+
+private:
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_position = 0;
+    QString m_errorString;
+    int m_lightsCount = 0;
+    bool m_loop = false;
+    bool m_fresh = false;
+
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_due = 0;
+    qint64 m_loopStart = 0;
+    QByteArray m_frame;
+
+    bool readVarint(quint32 *value);
+    bool decodeFrame();
+    void scheduleNext();
+};
+
+#endif // BOBRECORDING_H
@@ -0,0 +1,64 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobstatereporter.h"
+
+BobStateReporter::BobStateReporter(QObject *parent) :
+    QObject(parent)
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(0);
+    connect(m_flushTimer, &QTimer::timeout, this, &BobStateReporter::flush);
+}
+
+void BobStateReporter::setInterval(int msecs)
+{
+    m_flushTimer->setInterval(qMax(0, msecs));
+}
+
+void BobStateReporter::setStateValue(Device *device, const StateTypeId &stateTypeId, const QVariant &value)
+{
+    m_pendingStates[device].insert(stateTypeId, value);
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void BobStateReporter::removeDevice(Device *device)
+{
+    m_pendingStates.remove(device);
+}
+
+void BobStateReporter::flush()
+{
+    m_flushTimer->stop();
+
+    QHash<Device *, QHash<StateTypeId, QVariant> > pendingStates;
+    pendingStates.swap(m_pendingStates);
+
+    QHash<Device *, QHash<StateTypeId, QVariant> >::const_iterator device;
+    for (device = pendingStates.constBegin(); device != pendingStates.constEnd(); ++device) {
+        QHash<StateTypeId, QVariant>::const_iterator state;
+        for (state = device->constBegin(); state != device->constEnd(); ++state) {
+            device.key()->setStateValue(state.key(), state.value());
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBSTATEREPORTER_H
+#define BOBSTATEREPORTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QVariant>
+
+#include "plugin/device.h"
+
+// Collects state changes of the devices of one boblight server and writes only
+// the latest value of each state to nymea, at most once per interval.
+class BobStateReporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobStateReporter(QObject *parent = 0);
+
+    // 0 flushes on the next event loop iteration
+    void setInterval(int msecs);
+
+    void setStateValue(Device *device, const StateTypeId &stateTypeId, const QVariant &value);
+    void removeDevice(Device *device);
+
+public slots:
+    void flush();
+
+private:
+    QTimer *m_flushTimer;
+    QHash<Device *, QHash<StateTypeId, QVariant> > m_pendingStates;
+};
+
+#endif // BOBSTATEREPORTER_H
@@ -0,0 +1,209 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "bobstreaminput.h"
+#include "extern-plugininfo.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDir>
+#include <QFile>
+
+#include <string.h>
+#include <sys/stat.h>
+
+BobStreamInput::BobStreamInput(QObject *parent) :
+    QObject(parent)
+{
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    m_server->setMaxPendingConnections(1);
+    connect(m_server, &QLocalServer::newConnection, this, &BobStreamInput::onNewConnection);
+
+    m_staleTimer = new QTimer(this);
+    m_staleTimer->setSingleShot(true);
+    m_staleTimer->setInterval(1000);
+    connect(m_staleTimer, &QTimer::timeout, this, &BobStreamInput::onStaleTimeout);
+}
+
+bool BobStreamInput::listen(const QString &path)
+{
+    close();
+
+    // A previous instance which didn't shut down cleanly leaves the socket file behind.
+    // Only ever remove a socket though, the path comes from a device param.
+    QString fileName = QDir::isAbsolutePath(path) ? path : QDir::tempPath() + "/" + path;
+    struct stat info;
+    if (lstat(QFile::encodeName(fileName).constData(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            qCWarning(dcBoblight) << "Could not listen for frame streams on" << fileName << "File exists and is not a socket";
+            return false;
+        }
+        QLocalServer::removeServer(path);
+    }
+    if (!m_server->listen(path)) {
+        qCWarning(dcBoblight) << "Could not listen for frame streams on" << path << m_server->errorString();
+        return false;
+    }
+    qCDebug(dcBoblight) << "Listening for frame streams on" << m_server->fullServerName();
+    return true;
+}
+
+void BobStreamInput::close()
+{
+    if (m_client) {
+        m_client->disconnect(this);
+        m_client->abort();
+        m_client->deleteLater();
+        m_client = nullptr;
+    }
+    m_server->close();
+    onStaleTimeout();
+}
+
+void BobStreamInput::setFrameSize(int bytes)
+{
+    if (bytes == m_incoming.size()) {
+        return;
+    }
+    // Whatever the producer is in the middle of doesn't match the new size
+    dropProducer("Frame size changed");
+    m_incoming.fill(0, bytes);
+    m_latest.fill(0, bytes);
+    m_incomingFill = 0;
+    m_fresh = false;
+}
+
+bool BobStreamInput::active() const
+{
+    return m_active;
+}
+
+void BobStreamInput::setStaleTimeout(int msecs)
+{
+    m_staleTimer->setInterval(msecs);
+}
+
+bool BobStreamInput::takeFrame(quint8 *rgb)
+{
+    if (!m_fresh) {
+        return false;
+    }
+    memcpy(rgb, m_latest.constData(), m_latest.size());
+    m_fresh = false;
+    return true;
+}
+
+quint64 BobStreamInput::framesReceived() const
+{
+    return m_framesReceived;
+}
+
+quint64 BobStreamInput::framesDropped() const
+{
+    return m_framesDropped;
+}
+
+void BobStreamInput::onNewConnection()
+{
+    // One producer at a time, a new one takes over
+    QLocalSocket *client = m_server->nextPendingConnection();
+    if (m_client) {
+        qCDebug(dcBoblight) << "Frame stream producer replaced";
+        m_client->disconnect(this);
+        m_client->abort();
+        m_client->deleteLater();
+    }
+    m_client = client;
+    m_incomingFill = 0;
+    connect(m_client, &QLocalSocket::readyRead, this, &BobStreamInput::onReadyRead);
+    connect(m_client, &QLocalSocket::disconnected, this, &BobStreamInput::onClientDisconnected);
+}
+
+void BobStreamInput::onReadyRead()
+{
+    int frameSize = m_incoming.size();
+    if (frameSize == 0) {
+        // Not connected to boblightd yet, nothing to map the data to. Frames have no
+        // header, so the producer has to start over at a frame boundary later on.
+        dropProducer("Frame size not known yet");
+        return;
+    }
+
+    bool received = false;
+    while (m_client->bytesAvailable() > 0) {
+        qint64 read = m_client->read(m_incoming.data() + m_incomingFill, frameSize - m_incomingFill);
+        if (read <= 0) {
+            break;
+        }
+        m_incomingFill += read;
+        if (m_incomingFill == frameSize) {
+            m_incoming.swap(m_latest);
+            m_incomingFill = 0;
+            m_framesReceived++;
+            if (m_fresh) {
+                m_framesDropped++;
+            }
+            m_fresh = true;
+            received = true;
+        }
+    }
+
+    if (!received) {
+        return;
+    }
+    m_staleTimer->start();
+    if (!m_active) {
+        m_active = true;
+        emit activeChanged(true);
+    }
+    emit frameAvailable();
+}
+
+void BobStreamInput::dropProducer(const char *reason)
+{
+    if (!m_client) {
+        return;
+    }
+    qCDebug(dcBoblight) << "Dropping frame stream producer:" << reason;
+    m_client->disconnect(this);
+    m_client->abort();
+    m_client->deleteLater();
+    m_client = nullptr;
+    m_incomingFill = 0;
+}
+
+void BobStreamInput::onClientDisconnected()
+{
+    qCDebug(dcBoblight) << "Frame stream producer disconnected";
+    m_client->deleteLater();
+    m_client = nullptr;
+    m_incomingFill = 0;
+}
+
+void BobStreamInput::onStaleTimeout()
+{
+    m_staleTimer->stop();
+    m_fresh = false;
+    if (m_active) {
+        m_active = false;
+        emit activeChanged(false);
+    }
+}
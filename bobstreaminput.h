@@ -0,0 +1,85 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Copyright (C) 2018 Michael Zanetti <michael.zanetti@guh.io>            *
+ *                                                                         *
+ *  This file is part of guh.                                              *
+ *                                                                         *
+ *  Guh is free software: you can redistribute it and/or modify            *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, version 2 of the License.                *
+ *                                                                         *
+ *  Guh is distributed in the hope that it will be useful,                 *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with guh. If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef BOBSTREAMINPUT_H
+#define BOBSTREAMINPUT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QTimer>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Accepts raw frames (3 bytes R, G, B per light, back to back) from a local producer
+// on a UNIX domain socket. Only the newest complete frame is kept, frames arriving
+// faster than BobClient sends them are dropped. Frames have no header, so whenever
+// the position in the stream is lost the producer is disconnected and has to
+// reconnect, starting with a new frame.
+class BobStreamInput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BobStreamInput(QObject *parent = 0);
+
+    bool listen(const QString &path);
+    void close();
+
+    void setFrameSize(int bytes);
+
+    // True while frames keep coming in, the stream goes inactive after staleTimeout ms without one
+    bool active() const;
+    void setStaleTimeout(int msecs);
+
+    // Copies the newest frame to rgb if it hasn't been taken yet
+    bool takeFrame(quint8 *rgb);
+
+    quint64 framesReceived() const;
+    quint64 framesDropped() const;
+
+signals:
+    void frameAvailable();
+    void activeChanged(bool active);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onClientDisconnected();
+    void onStaleTimeout();
+
+private:
+    void dropProducer(const char *reason);
+
+    QLocalServer *m_server;
+    QLocalSocket *m_client = nullptr;
+    QTimer *m_staleTimer;
+    bool m_active = false;
+
+    // Frames are received into m_incoming and swapped with m_latest once complete
+    QByteArray m_incoming;
+    QByteArray m_latest;
+    int m_incomingFill = 0;
+    bool m_fresh = false;
+
+    quint64 m_framesReceived = 0;
+    quint64 m_framesDropped = 0;
+};
+
+#endif // BOBSTREAMINPUT_H
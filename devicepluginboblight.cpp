@@ -52,27 +52,77 @@
 #include "devicemanager.h"
 
 #include "bobclient.h"
+#include "bobcolortemperature.h"
+#include "bobgroup.h"
+#include "bobstatereporter.h"
 #include "plugininfo.h"
-#include "plugintimer.h"
 
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QNetworkConfigurationManager>
+#include <QStandardPaths>
 #include <QStringList>
 #include <QtMath>
 
+static BobAnimator::Easing easingFromString(const QString &easing)
+{
+    if (easing == "linear") {
+        return BobAnimator::EasingLinear;
+    } else if (easing == "inOut") {
+        return BobAnimator::EasingInOut;
+    } else if (easing == "in") {
+        return BobAnimator::EasingIn;
+    } else if (easing == "out") {
+        return BobAnimator::EasingOut;
+    }
+    return BobAnimator::EasingDefault;
+}
+
 DevicePluginBoblight::DevicePluginBoblight()
 {
 }
 
 void DevicePluginBoblight::init()
 {
-    m_pluginTimer = hardwareManager()->pluginTimerManager()->registerTimer(15);
-    connect(m_pluginTimer, &PluginTimer::timeout, this, &DevicePluginBoblight::guhTimer);
+    // Clients reconnect on their own with a backoff, this only cuts the wait short when the network comes back
+    m_networkManager = new QNetworkConfigurationManager(this);
+    connect(m_networkManager, &QNetworkConfigurationManager::onlineStateChanged, this, &DevicePluginBoblight::onOnlineStateChanged);
 }
 
 void DevicePluginBoblight::deviceRemoved(Device *device)
 {
+    if (device->deviceClassId() == boblightDeviceClassId) {
+        BobClient *client = m_bobClients.take(device->id());
+        int channel = device->paramValue(boblightChannelParamTypeId).toInt();
+        if (m_channelDevices.contains(client) && m_channelDevices[client].value(channel) == device) {
+            m_channelDevices[client].remove(channel);
+            m_announcedChannels[client].remove(channel);
+        }
+        if (m_stateReporters.contains(client)) {
+            m_stateReporters.value(client)->removeDevice(device);
+        }
+    }
+    if (device->deviceClassId() == boblightGroupDeviceClassId) {
+        m_groupDevices.remove(device->paramValue(boblightGroupGroupNameParamTypeId).toString(), device);
+    }
     if (device->deviceClassId() == boblightServerDeviceClassId) {
         BobClient *client = m_bobClients.take(device->id());
+        m_pendingSetups.remove(client);
+        m_serverDevices.remove(client);
+        m_channelDevices.remove(client);
+        m_announcedChannels.remove(client);
+        delete m_stateReporters.take(client);
+
+        BobGroup *group = m_groups.value(device->paramValue(boblightServerGroupParamTypeId).toString());
+        if (group) {
+            group->removeClient(client);
+            if (group->clients().isEmpty()) {
+                m_groups.remove(group->name());
+                delete group;
+            }
+            updateGroupDevices(device->paramValue(boblightServerGroupParamTypeId).toString());
+        }
         client->deleteLater();
     }
 }
@@ -80,140 +130,176 @@ void DevicePluginBoblight::deviceRemoved(Device *device)
 void DevicePluginBoblight::startMonitoringAutoDevices()
 {
     m_canCreateAutoDevices = true;
-    qCDebug(dcBoblight()) << "Populating auto devices" << myDevices().count();
-    QHash<DeviceId, int> parentDevices;
-    QHash<DeviceId, Device*> deviceIds;
-    foreach (Device *device, myDevices()) {
-        deviceIds.insert(device->id(), device);
-        if (device->deviceClassId() == boblightServerDeviceClassId) {
-            qWarning() << "Device" << device->id() << "is bridge";
-            if (!parentDevices.contains(device->id())) {
-                parentDevices[device->id()] = 0;
-            }
-        } else if (device->deviceClassId() == boblightDeviceClassId) {
-            qWarning() << "Device" << device->id() << "is child to bridge" << device->parentId();
-            parentDevices[device->parentId()] += 1;
+    foreach (BobClient *bobClient, m_serverDevices.keys()) {
+        // Servers still being set up get their channels once the connection attempt
+        // resolved, disconnected ones once they're back and their lights are known
+        if (m_pendingSetups.contains(bobClient) || !bobClient->connected()) {
+            continue;
         }
+        populateChannels(bobClient);
+    }
+}
+
+void DevicePluginBoblight::populateChannels(BobClient *bobClient)
+{
+    Device *serverDevice = m_serverDevices.value(bobClient);
+    if (!serverDevice || !m_canCreateAutoDevices) {
+        return;
     }
-    qWarning() << "have bridge devices:" << parentDevices.count();
+
+    // boblightd knows best, the channels param is only used until it has been reached once
+    int count = bobClient->connected() ? bobClient->lightsCount() : serverDevice->paramValue(boblightServerChannelsParamTypeId).toInt();
+    const QHash<int, Device *> channels = m_channelDevices.value(bobClient);
+    QSet<int> &announced = m_announcedChannels[bobClient];
+
     QList<DeviceDescriptor> descriptors;
-    foreach (const DeviceId &id, parentDevices.keys()) {
-        if (parentDevices.value(id) < deviceIds.value(id)->paramValue(boblightServerChannelsParamTypeId).toInt()) {
-            for (int i = parentDevices.value(id); i < deviceIds.value(id)->paramValue(boblightServerChannelsParamTypeId).toInt(); i++) {
-                DeviceDescriptor descriptor(boblightDeviceClassId, deviceIds.value(id)->name() + " " + QString::number(i + 1), QString(), id);
-                descriptor.setParams(ParamList() << Param(boblightChannelParamTypeId, i));
-                qCDebug(dcBoblight()) << "Adding new boblight channel" << i + 1;
-                descriptors.append(descriptor);
-            }
+    for (int i = 0; i < count; ++i) {
+        if (channels.contains(i) || announced.contains(i)) {
+            continue;
         }
+        DeviceDescriptor descriptor(boblightDeviceClassId, serverDevice->name() + " " + QString::number(i + 1), QString(), serverDevice->id());
+        descriptor.setParams(ParamList() << Param(boblightChannelParamTypeId, i));
+        descriptors.append(descriptor);
+        announced.insert(i);
     }
     if (!descriptors.isEmpty()) {
+        qCDebug(dcBoblight()) << "Adding" << descriptors.count() << "boblight channels to" << serverDevice->name();
         emit autoDevicesAppeared(boblightDeviceClassId, descriptors);
     }
 }
 
-void DevicePluginBoblight::guhTimer()
+void DevicePluginBoblight::onOnlineStateChanged(bool online)
 {
-    foreach (BobClient *client, m_bobClients) {
-        if (!client->connected()) {
-            client->connectToBoblight();
-        }
+    if (!online) {
+        return;
+    }
+    foreach (BobClient *client, m_serverDevices.keys()) {
+        client->reconnectNow();
     }
 }
 
 void DevicePluginBoblight::onPowerChanged(int channel, bool power)
 {
     qCDebug(dcBoblight()) << "power changed" << channel << power;
-    BobClient *sndr = dynamic_cast<BobClient*>(sender());
-    foreach (Device* device, myDevices()) {
-        if (m_bobClients.value(device->parentId()) == sndr && device->paramValue(boblightChannelParamTypeId).toInt() == channel) {
-            qCWarning(dcBoblight()) << "setting state power" << power;
-            device->setStateValue(boblightPowerStateTypeId, power);
-        }
+    Device *device = channelDevice(static_cast<BobClient *>(sender()), channel);
+    if (device) {
+        m_stateReporters.value(static_cast<BobClient *>(sender()))->setStateValue(device, boblightPowerStateTypeId, power);
     }
 }
 
 void DevicePluginBoblight::onBrightnessChanged(int channel, int brightness)
 {
-    BobClient *sndr = dynamic_cast<BobClient*>(sender());
-    foreach (Device* device, myDevices()) {
-        if (m_bobClients.value(device->parentId()) == sndr && device->paramValue(boblightChannelParamTypeId).toInt() == channel) {
-            device->setStateValue(boblightBrightnessStateTypeId, brightness);
-        }
+    Device *device = channelDevice(static_cast<BobClient *>(sender()), channel);
+    if (device) {
+        m_stateReporters.value(static_cast<BobClient *>(sender()))->setStateValue(device, boblightBrightnessStateTypeId, brightness);
     }
 }
 
 void DevicePluginBoblight::onColorChanged(int channel, const QColor &color)
 {
-    BobClient *sndr = dynamic_cast<BobClient*>(sender());
-    foreach (Device* device, myDevices()) {
-        if (m_bobClients.value(device->parentId()) == sndr && device->paramValue(boblightChannelParamTypeId).toInt() == channel) {
-            device->setStateValue(boblightColorStateTypeId, color);
-        }
+    Device *device = channelDevice(static_cast<BobClient *>(sender()), channel);
+    if (device) {
+        m_stateReporters.value(static_cast<BobClient *>(sender()))->setStateValue(device, boblightColorStateTypeId, color);
     }
 }
 
 void DevicePluginBoblight::onPriorityChanged(int priority)
 {
-    BobClient *sndr = dynamic_cast<BobClient*>(sender());
-    foreach (Device* device, myDevices()) {
-        if (m_bobClients.value(device->id()) == sndr) {
-            device->setStateValue(boblightServerPriorityStateTypeId, priority);
-        }
+    BobClient *bobClient = static_cast<BobClient *>(sender());
+    Device *device = m_serverDevices.value(bobClient);
+    if (device) {
+        m_stateReporters.value(bobClient)->setStateValue(device, boblightServerPriorityStateTypeId, priority);
     }
 }
 
-QColor DevicePluginBoblight::tempToRgb(int temp)
+void DevicePluginBoblight::onMetricsChanged()
 {
-    //  153   cold: 0.839216, 1, 0.827451
-    //  500   warm: 0.870588, 1, 0.266667
-
-    //   =>  0 : 214,255,212
-    //       100 : 222,255,67
-
-    //  r => 0 : 214 = 100 : 222
-    //    => temp : (x-214) = 100 : (255 - 214)
-    //    => x = temp * (255-214) / 100
-    //       r = x + 214
-
-    int red = temp * 41 / 100 + 214;
-
-    int green = 255;
-
-    //  b => 0 : 212 = 100 : 67
-    //    => temp : (212 - x) = 100 : (212 - 145)
-    //    => x = temp * 145 / 100
-    //       g = 212 - x
+    BobClient *bobClient = static_cast<BobClient *>(sender());
+    Device *device = m_serverDevices.value(bobClient);
+    if (!device) {
+        return;
+    }
 
-    int blue = 212 - temp * 145 / 100;
+    BobStateReporter *stateReporter = m_stateReporters.value(bobClient);
+    stateReporter->setStateValue(device, boblightServerFramesSentStateTypeId, bobClient->framesSent());
+    stateReporter->setStateValue(device, boblightServerFramesSkippedStateTypeId, bobClient->framesSkipped());
+    if (bobClient->countsBytesWritten()) {
+        stateReporter->setStateValue(device, boblightServerBytesWrittenStateTypeId, static_cast<double>(bobClient->bytesWritten()));
+    }
+    stateReporter->setStateValue(device, boblightServerSendLatency50StateTypeId, bobClient->sendLatency(50));
+    stateReporter->setStateValue(device, boblightServerSendLatency95StateTypeId, bobClient->sendLatency(95));
+    stateReporter->setStateValue(device, boblightServerSendLatency99StateTypeId, bobClient->sendLatency(99));
+    stateReporter->setStateValue(device, boblightServerReconnectAttemptsStateTypeId, bobClient->reconnectAttempts());
+    stateReporter->setStateValue(device, boblightServerUptimeStateTypeId, bobClient->uptime());
+}
 
-    qWarning() << "temp:" << temp << "rgb" << red << green << blue;
-    return QColor(red, green, blue);
+Device *DevicePluginBoblight::channelDevice(BobClient *bobClient, int channel) const
+{
+    QHash<BobClient *, QHash<int, Device *> >::const_iterator it = m_channelDevices.constFind(bobClient);
+    if (it == m_channelDevices.constEnd()) {
+        return nullptr;
+    }
+    return it->value(channel);
 }
 
 DeviceManager::DeviceSetupStatus DevicePluginBoblight::setupDevice(Device *device)
 {
     if (device->deviceClassId() == boblightServerDeviceClassId) {
 
-        BobClient *bobClient = new BobClient(device->paramValue(boblightServerHostAddressParamTypeId).toString(), device->paramValue(boblightServerPortParamTypeId).toInt(), this);
-        bool connected = bobClient->connectToBoblight();
-        if (!connected) {
-            qCWarning(dcBoblight()) << "Error connecting to boblight...";
-        } else {
-            qCDebug(dcBoblight()) << "Connected to boblight";
-        }
+        BobClient::Protocol protocol = device->paramValue(boblightServerProtocolParamTypeId).toString() == "native" ? BobClient::ProtocolNative : BobClient::ProtocolLibBoblight;
+        BobClient *bobClient = new BobClient(device->paramValue(boblightServerHostAddressParamTypeId).toString(), device->paramValue(boblightServerPortParamTypeId).toInt(), protocol, this);
         bobClient->setPriority(device->stateValue(boblightServerPriorityStateTypeId).toInt());
-        device->setStateValue(boblightServerConnectedStateTypeId, connected);
+        bobClient->setKeepAliveInterval(device->paramValue(boblightServerKeepAliveIntervalParamTypeId).toInt());
+        bobClient->setFrameRate(device->paramValue(boblightServerFrameRateParamTypeId).toInt());
+        QString outputCurve = device->paramValue(boblightServerOutputCurveParamTypeId).toString();
+        if (outputCurve == "gamma") {
+            bobClient->setOutputCurve(BobOutputStage::CurveGamma, device->paramValue(boblightServerGammaParamTypeId).toDouble());
+        } else if (outputCurve == "perceptual") {
+            bobClient->setOutputCurve(BobOutputStage::CurvePerceptual);
+        }
+        bobClient->setDithering(device->paramValue(boblightServerDitheringParamTypeId).toBool());
+        bobClient->setStreamSocket(device->paramValue(boblightServerStreamSocketParamTypeId).toString());
+        bobClient->setTransition(device->paramValue(boblightServerTransitionDurationParamTypeId).toInt(),
+                                 easingFromString(device->paramValue(boblightServerTransitionEasingParamTypeId).toString()));
+
+        QString groupName = device->paramValue(boblightServerGroupParamTypeId).toString();
+        if (!groupName.isEmpty()) {
+            BobGroup *group = m_groups.value(groupName);
+            if (!group) {
+                group = new BobGroup(groupName, this);
+                m_groups.insert(groupName, group);
+            }
+            group->addClient(bobClient);
+        }
         m_bobClients.insert(device->id(), bobClient);
+        m_serverDevices.insert(bobClient, device);
+        m_pendingSetups.insert(bobClient, device);
+
+        BobStateReporter *stateReporter = new BobStateReporter(this);
+        stateReporter->setInterval(device->paramValue(boblightServerStateUpdateIntervalParamTypeId).toInt());
+        m_stateReporters.insert(bobClient, stateReporter);
+
+        connect(bobClient, &BobClient::connectFinished, this, &DevicePluginBoblight::onConnectFinished);
         connect(bobClient, &BobClient::connectionChanged, this, &DevicePluginBoblight::onConnectionChanged);
         connect(bobClient, &BobClient::powerChanged, this, &DevicePluginBoblight::onPowerChanged);
         connect(bobClient, &BobClient::brightnessChanged, this, &DevicePluginBoblight::onBrightnessChanged);
         connect(bobClient, &BobClient::colorChanged, this, &DevicePluginBoblight::onColorChanged);
         connect(bobClient, &BobClient::priorityChanged, this, &DevicePluginBoblight::onPriorityChanged);
+        connect(bobClient, &BobClient::metricsChanged, this, &DevicePluginBoblight::onMetricsChanged);
+
+        // The setup finishes in onConnectFinished() once the connection attempt resolved
+        bobClient->connectToBoblight();
+        return DeviceManager::DeviceSetupStatusAsync;
     } else if (device->deviceClassId() == boblightDeviceClassId) {
         BobClient *bobClient = m_bobClients.value(device->parentId());
         device->setStateValue(boblightConnectedStateTypeId, bobClient->connected());
         m_bobClients.insert(device->id(), bobClient);
+        m_channelDevices[bobClient].insert(device->paramValue(boblightChannelParamTypeId).toInt(), device);
+    } else if (device->deviceClassId() == boblightGroupDeviceClassId) {
+        QString groupName = device->paramValue(boblightGroupGroupNameParamTypeId).toString();
+        BobGroup *group = m_groups.value(groupName);
+        device->setStateValue(boblightGroupConnectedStateTypeId, group && group->connected());
+        m_groupDevices.insert(groupName, device);
     }
 
     return DeviceManager::DeviceSetupStatusSuccess;
@@ -221,26 +307,29 @@ DeviceManager::DeviceSetupStatus DevicePluginBoblight::setupDevice(Device *devic
 
 void DevicePluginBoblight::postSetupDevice(Device *device)
 {
-    if (device->deviceClassId() == boblightServerDeviceClassId && m_canCreateAutoDevices) {
-        startMonitoringAutoDevices();
+    if (device->deviceClassId() == boblightServerDeviceClassId) {
+        populateChannels(m_bobClients.value(device->id()));
     }
     if (device->deviceClassId() == boblightDeviceClassId) {
         BobClient *bobClient = m_bobClients.value(device->parentId());
         if (bobClient && bobClient->connected()) {
             device->setStateValue(boblightConnectedStateTypeId, bobClient->connected());
-
-            QColor color = device->stateValue(boblightColorStateTypeId).value<QColor>();
-            int brightness = device->stateValue(boblightBrightnessStateTypeId).toInt();
-            bool power = device->stateValue(boblightPowerStateTypeId).toBool();
-
-            bobClient->setColor(device->paramValue(boblightChannelParamTypeId).toInt(), color);
-            bobClient->setBrightness(device->paramValue(boblightChannelParamTypeId).toInt(), brightness);
-            bobClient->setPower(device->paramValue(boblightChannelParamTypeId).toInt(), power);
-
+            restoreChannel(bobClient, device);
         }
     }
 }
 
+void DevicePluginBoblight::restoreChannel(BobClient *bobClient, Device *device)
+{
+    QColor color = device->stateValue(boblightColorStateTypeId).value<QColor>();
+    int brightness = device->stateValue(boblightBrightnessStateTypeId).toInt();
+    bool power = device->stateValue(boblightPowerStateTypeId).toBool();
+
+    bobClient->setColor(device->paramValue(boblightChannelParamTypeId).toInt(), color);
+    bobClient->setBrightness(device->paramValue(boblightChannelParamTypeId).toInt(), brightness);
+    bobClient->setPower(device->paramValue(boblightChannelParamTypeId).toInt(), power);
+}
+
 DeviceManager::DeviceError DevicePluginBoblight::executeAction(Device *device, const Action &action)
 {
     if (!device->setupComplete()) {
@@ -258,6 +347,137 @@ DeviceManager::DeviceError DevicePluginBoblight::executeAction(Device *device, c
             bobClient->setPriority(action.param(boblightServerPriorityActionParamTypeId).value().toInt());
             return DeviceManager::DeviceErrorNoError;
         }
+        if (action.actionTypeId() == boblightServerSetColorsActionTypeId) {
+            QList<QColor> colors;
+            foreach (const QString &name, action.param(boblightServerSetColorsActionColorsParamTypeId).value().toString().split(QRegExp("[,;\\s]+"), QString::SkipEmptyParts)) {
+                QColor color(name);
+                if (!color.isValid()) {
+                    qCWarning(dcBoblight()) << "Invalid color" << name << "in" << action.actionTypeId();
+                    return DeviceManager::DeviceErrorInvalidParameter;
+                }
+                colors.append(color);
+            }
+            bobClient->setColors(action.param(boblightServerSetColorsActionFirstChannelParamTypeId).value().toInt(), colors,
+                                 action.param(boblightServerSetColorsActionDurationParamTypeId).value().toInt(),
+                                 easingFromString(action.param(boblightServerSetColorsActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerFillRangeActionTypeId) {
+            int first = action.param(boblightServerFillRangeActionFirstChannelParamTypeId).value().toInt();
+            int last = action.param(boblightServerFillRangeActionLastChannelParamTypeId).value().toInt();
+            if (last < 0 || last >= bobClient->lightsCount()) {
+                last = bobClient->lightsCount() - 1;
+            }
+            QList<QColor> colors;
+            for (int i = first; i <= last; ++i) {
+                colors.append(action.param(boblightServerFillRangeActionColorParamTypeId).value().value<QColor>());
+            }
+            bobClient->setColors(first, colors,
+                                 action.param(boblightServerFillRangeActionDurationParamTypeId).value().toInt(),
+                                 easingFromString(action.param(boblightServerFillRangeActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerSetGradientActionTypeId) {
+            int first = action.param(boblightServerSetGradientActionFirstChannelParamTypeId).value().toInt();
+            int last = action.param(boblightServerSetGradientActionLastChannelParamTypeId).value().toInt();
+            if (last < 0 || last >= bobClient->lightsCount()) {
+                last = bobClient->lightsCount() - 1;
+            }
+            QColor start = action.param(boblightServerSetGradientActionStartColorParamTypeId).value().value<QColor>();
+            QColor end = action.param(boblightServerSetGradientActionEndColorParamTypeId).value().value<QColor>();
+            QList<QColor> colors;
+            for (int i = first; i <= last; ++i) {
+                qreal progress = last > first ? qreal(i - first) / (last - first) : 0;
+                colors.append(QColor(qRound(start.red() + (end.red() - start.red()) * progress),
+                                     qRound(start.green() + (end.green() - start.green()) * progress),
+                                     qRound(start.blue() + (end.blue() - start.blue()) * progress),
+                                     qRound(start.alpha() + (end.alpha() - start.alpha()) * progress)));
+            }
+            bobClient->setColors(first, colors,
+                                 action.param(boblightServerSetGradientActionDurationParamTypeId).value().toInt(),
+                                 easingFromString(action.param(boblightServerSetGradientActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStartEffectActionTypeId) {
+            QString name = action.param(boblightServerStartEffectActionEffectParamTypeId).value().toString();
+            BobEffectEngine::Effect effect = BobEffectEngine::EffectRainbow;
+            if (name == "breathing") {
+                effect = BobEffectEngine::EffectBreathing;
+            } else if (name == "chase") {
+                effect = BobEffectEngine::EffectChase;
+            } else if (name == "candle") {
+                effect = BobEffectEngine::EffectCandle;
+            }
+            bobClient->startEffect(effect,
+                                   action.param(boblightServerStartEffectActionColorParamTypeId).value().value<QColor>(),
+                                   action.param(boblightServerStartEffectActionSpeedParamTypeId).value().toInt(),
+                                   action.param(boblightServerStartEffectActionFirstChannelParamTypeId).value().toInt(),
+                                   action.param(boblightServerStartEffectActionLastChannelParamTypeId).value().toInt());
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStopEffectActionTypeId) {
+            bobClient->stopEffect();
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStartRecordingActionTypeId) {
+            QString fileName = recordingPath(action.param(boblightServerStartRecordingActionFileNameParamTypeId).value().toString());
+            if (fileName.isEmpty() || !bobClient->startRecording(fileName)) {
+                return DeviceManager::DeviceErrorInvalidParameter;
+            }
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStopRecordingActionTypeId) {
+            bobClient->stopRecording();
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStartPlaybackActionTypeId) {
+            QString fileName = recordingPath(action.param(boblightServerStartPlaybackActionFileNameParamTypeId).value().toString());
+            if (fileName.isEmpty() || !bobClient->startPlayback(fileName, action.param(boblightServerStartPlaybackActionLoopParamTypeId).value().toBool())) {
+                return DeviceManager::DeviceErrorInvalidParameter;
+            }
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerStopPlaybackActionTypeId) {
+            bobClient->stopPlayback();
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerSetOverrideActionTypeId) {
+            int last = action.param(boblightServerSetOverrideActionLastChannelParamTypeId).value().toInt();
+            if (last < 0 || last >= bobClient->lightsCount()) {
+                last = bobClient->lightsCount() - 1;
+            }
+            bobClient->setOverride(action.param(boblightServerSetOverrideActionFirstChannelParamTypeId).value().toInt(), last,
+                                   action.param(boblightServerSetOverrideActionColorParamTypeId).value().value<QColor>());
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerClearOverrideActionTypeId) {
+            int last = action.param(boblightServerClearOverrideActionLastChannelParamTypeId).value().toInt();
+            if (last < 0 || last >= bobClient->lightsCount()) {
+                last = bobClient->lightsCount() - 1;
+            }
+            bobClient->clearOverride(action.param(boblightServerClearOverrideActionFirstChannelParamTypeId).value().toInt(), last);
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightServerConfigureLayerActionTypeId) {
+            QString layerName = action.param(boblightServerConfigureLayerActionLayerParamTypeId).value().toString();
+            BobCompositor::Layer layer = BobCompositor::LayerOverride;
+            if (layerName == "effect") {
+                layer = BobCompositor::LayerEffect;
+            } else if (layerName == "stream") {
+                layer = BobCompositor::LayerStream;
+            }
+            QString blendModeName = action.param(boblightServerConfigureLayerActionBlendModeParamTypeId).value().toString();
+            BobCompositor::BlendMode blendMode = BobCompositor::BlendNormal;
+            if (blendModeName == "add") {
+                blendMode = BobCompositor::BlendAdd;
+            } else if (blendModeName == "multiply") {
+                blendMode = BobCompositor::BlendMultiply;
+            } else if (blendModeName == "screen") {
+                blendMode = BobCompositor::BlendScreen;
+            }
+            bobClient->setLayer(layer, qRound(action.param(boblightServerConfigureLayerActionOpacityParamTypeId).value().toInt() * 255.0 / 100), blendMode);
+            return DeviceManager::DeviceErrorNoError;
+        }
         qCWarning(dcBoblight()) << "Unhandled action" << action.actionTypeId() << "for BoblightServer device" << device;
         return DeviceManager::DeviceErrorActionTypeNotFound;
     }
@@ -282,7 +502,64 @@ DeviceManager::DeviceError DevicePluginBoblight::executeAction(Device *device, c
             return DeviceManager::DeviceErrorNoError;
         }
         if (action.actionTypeId() == boblightColorTemperatureActionTypeId) {
-            bobClient->setColor(device->paramValue(boblightChannelParamTypeId).toInt(), tempToRgb(action.param(boblightColorTemperatureActionParamTypeId).value().toInt()));
+            bobClient->setColor(device->paramValue(boblightChannelParamTypeId).toInt(), QColor(BobColorTemperature::toRgb(action.param(boblightColorTemperatureActionParamTypeId).value().toInt())));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        // The state actions can't carry any extra params, these do the same with their own transition
+        if (action.actionTypeId() == boblightFadePowerActionTypeId) {
+            bobClient->setPower(device->paramValue(boblightChannelParamTypeId).toInt(), action.param(boblightFadePowerActionPowerParamTypeId).value().toBool(),
+                                action.param(boblightFadePowerActionDurationParamTypeId).value().toInt(),
+                                easingFromString(action.param(boblightFadePowerActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightFadeColorActionTypeId) {
+            bobClient->setColor(device->paramValue(boblightChannelParamTypeId).toInt(), action.param(boblightFadeColorActionColorParamTypeId).value().value<QColor>(),
+                                action.param(boblightFadeColorActionDurationParamTypeId).value().toInt(),
+                                easingFromString(action.param(boblightFadeColorActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightFadeBrightnessActionTypeId) {
+            bobClient->setBrightness(device->paramValue(boblightChannelParamTypeId).toInt(), action.param(boblightFadeBrightnessActionBrightnessParamTypeId).value().toInt(),
+                                     action.param(boblightFadeBrightnessActionDurationParamTypeId).value().toInt(),
+                                     easingFromString(action.param(boblightFadeBrightnessActionEasingParamTypeId).value().toString()));
+            return DeviceManager::DeviceErrorNoError;
+        }
+        return DeviceManager::DeviceErrorActionTypeNotFound;
+    }
+
+    if (device->deviceClassId() == boblightGroupDeviceClassId) {
+        BobGroup *group = m_groups.value(device->paramValue(boblightGroupGroupNameParamTypeId).toString());
+        if (!group) {
+            qCWarning(dcBoblight()) << "No boblight server in group" << device->paramValue(boblightGroupGroupNameParamTypeId).toString();
+            return DeviceManager::DeviceErrorHardwareNotAvailable;
+        }
+
+        // Applied to all servers in the same event loop iteration, so it goes out on the same tick everywhere
+        if (action.actionTypeId() == boblightGroupPowerActionTypeId) {
+            bool power = action.param(boblightGroupPowerActionParamTypeId).value().toBool();
+            group->setPower(power);
+            device->setStateValue(boblightGroupPowerStateTypeId, power);
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightGroupColorActionTypeId) {
+            QColor color = action.param(boblightGroupColorActionParamTypeId).value().value<QColor>();
+            group->setColor(color);
+            device->setStateValue(boblightGroupColorStateTypeId, color);
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightGroupBrightnessActionTypeId) {
+            int brightness = action.param(boblightGroupBrightnessActionParamTypeId).value().toInt();
+            group->setBrightness(brightness);
+            device->setStateValue(boblightGroupBrightnessStateTypeId, brightness);
+            if (brightness > 0) {
+                device->setStateValue(boblightGroupPowerStateTypeId, true);
+            }
+            return DeviceManager::DeviceErrorNoError;
+        }
+        if (action.actionTypeId() == boblightGroupColorTemperatureActionTypeId) {
+            int temperature = action.param(boblightGroupColorTemperatureActionParamTypeId).value().toInt();
+            group->setColor(QColor(BobColorTemperature::toRgb(temperature)));
+            device->setStateValue(boblightGroupColorTemperatureStateTypeId, temperature);
             return DeviceManager::DeviceErrorNoError;
         }
         return DeviceManager::DeviceErrorActionTypeNotFound;
@@ -290,17 +567,74 @@ DeviceManager::DeviceError DevicePluginBoblight::executeAction(Device *device, c
     return DeviceManager::DeviceErrorDeviceClassNotFound;
 }
 
+void DevicePluginBoblight::onConnectFinished(bool success)
+{
+    BobClient *bobClient = static_cast<BobClient *>(sender());
+    Device *device = m_pendingSetups.take(bobClient);
+    if (!device) {
+        return;
+    }
+
+    if (!success) {
+        qCWarning(dcBoblight()) << "Error connecting to boblight...";
+    } else {
+        qCDebug(dcBoblight()) << "Connected to boblight";
+    }
+    device->setStateValue(boblightServerConnectedStateTypeId, success);
+    emit deviceSetupFinished(device, DeviceManager::DeviceSetupStatusSuccess);
+}
+
 void DevicePluginBoblight::onConnectionChanged()
 {
     BobClient *bobClient = static_cast<BobClient *>(sender());
-    qCDebug(dcBoblight()) << "Connection changed. BobClient:" << bobClient << bobClient->connected() << m_bobClients.keys(bobClient);
-    foreach (const DeviceId &deviceId, m_bobClients.keys(bobClient)) {
-        foreach (Device *device, myDevices()) {
-            if (device->id() == deviceId || device->parentId() == deviceId) {
-                device->setStateValue(boblightConnectedStateTypeId, bobClient->connected());
-                break;
-            }
-        }
+    qCDebug(dcBoblight()) << "Connection changed. BobClient:" << bobClient << bobClient->connected();
+    Device *serverDevice = m_serverDevices.value(bobClient);
+    if (serverDevice) {
+        serverDevice->setStateValue(boblightServerConnectedStateTypeId, bobClient->connected());
+    }
+
+    // BobClient keeps its channels across reconnects and restores them on its own. The
+    // device states may lag behind when reported in intervals, so they're not used here.
+    foreach (Device *device, m_channelDevices.value(bobClient)) {
+        device->setStateValue(boblightConnectedStateTypeId, bobClient->connected());
+    }
+    if (serverDevice) {
+        updateGroupDevices(serverDevice->paramValue(boblightServerGroupParamTypeId).toString());
+    }
+
+    // The server might have been reconfigured with more lights
+    if (bobClient->connected() && serverDevice && serverDevice->setupComplete()) {
+        populateChannels(bobClient);
+    }
+}
+
+QString DevicePluginBoblight::recordingPath(const QString &fileName) const
+{
+    // Recordings are plain file names in the plugin's own data directory, anything
+    // which could point elsewhere is refused
+    if (fileName.isEmpty() || fileName == "." || fileName == ".." || fileName.contains('/') || fileName.contains('\\')) {
+        qCWarning(dcBoblight) << "Invalid recording name" << fileName;
+        return QString();
+    }
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/boblight");
+    dir.mkpath(".");
+
+    // Don't follow a symlink planted in there either
+    QFileInfo info(dir.filePath(fileName));
+    if (info.isSymLink() || (info.exists() && !info.isFile())) {
+        qCWarning(dcBoblight) << "Recording" << fileName << "is not a regular file";
+        return QString();
     }
+    return info.filePath();
 }
 
+void DevicePluginBoblight::updateGroupDevices(const QString &groupName)
+{
+    if (groupName.isEmpty()) {
+        return;
+    }
+    BobGroup *group = m_groups.value(groupName);
+    foreach (Device *device, m_groupDevices.values(groupName)) {
+        device->setStateValue(boblightGroupConnectedStateTypeId, group && group->connected());
+    }
+}
@@ -24,8 +24,12 @@
 #include "plugin/deviceplugin.h"
 #include "bobclient.h"
 
+#include <QSet>
+
 class BobClient;
-class PluginTimer;
+class BobStateReporter;
+class BobGroup;
+class QNetworkConfigurationManager;
 
 class DevicePluginBoblight : public DevicePlugin
 {
@@ -48,20 +52,36 @@ public:
     DeviceManager::DeviceError executeAction(Device *device, const Action &action) override;
 
 private slots:
+    void onConnectFinished(bool success);
     void onConnectionChanged();
-    void guhTimer();
+    void onOnlineStateChanged(bool online);
 
     void onPowerChanged(int channel, bool power);
     void onBrightnessChanged(int channel, int brightness);
     void onColorChanged(int channel, const QColor &color);
     void onPriorityChanged(int priority);
+    void onMetricsChanged();
 
 private:
-    QColor tempToRgb(int temp);
+    void restoreChannel(BobClient *bobClient, Device *device);
+    Device *channelDevice(BobClient *bobClient, int channel) const;
+    void updateGroupDevices(const QString &groupName);
+    void populateChannels(BobClient *bobClient);
+    QString recordingPath(const QString &fileName) const;
 private:
-    PluginTimer *m_pluginTimer = nullptr;
+    QNetworkConfigurationManager *m_networkManager = nullptr;
 
     QHash<DeviceId, BobClient*> m_bobClients;
+    QHash<BobClient*, Device*> m_pendingSetups;
+
+    // Lookup from a client back to its devices, maintained in setupDevice()/deviceRemoved()
+    QHash<BobClient*, Device*> m_serverDevices;
+    QHash<BobClient*, QHash<int, Device*> > m_channelDevices;
+    // Channels handed to nymea with autoDevicesAppeared() which may not be set up yet
+    QHash<BobClient*, QSet<int> > m_announcedChannels;
+    QHash<BobClient*, BobStateReporter*> m_stateReporters;
+    QHash<QString, BobGroup*> m_groups;
+    QMultiHash<QString, Device*> m_groupDevices;
     bool m_canCreateAutoDevices = false;
 };
 